@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H 1
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include "scatter_buffer.h"
+
+namespace radix_hash {
+
+// Bloom filter whose probes for a hash all land in one cache line. The
+// line is picked by the top bits of the remixed hash, since std::hash of an
+// integer is the integer and would put every small key in line 0. insert
+// is not thread safe; threads filling one filter use insert_shared.
+class BlockedBloomFilter {
+ public:
+  static const int kWordsPerBlock = kCacheLineSize / sizeof(uint64_t);
+  static const int kBitsPerKey = 10;
+  static const int kProbes = 6;
+
+  explicit BlockedBloomFilter(std::size_t keys) {
+    void* mem;
+    std::size_t bits = keys * kBitsPerKey;
+    _block_bits = 1;
+    while ((kCacheLineSize * 8 << _block_bits) < bits && _block_bits < 40)
+      _block_bits++;
+    if (posix_memalign(&mem, kCacheLineSize, blocks() * kCacheLineSize) != 0)
+      throw std::bad_alloc();
+    _words = static_cast<uint64_t*>(mem);
+    std::memset(_words, 0, blocks() * kCacheLineSize);
+  }
+  BlockedBloomFilter(const BlockedBloomFilter&) = delete;
+  ~BlockedBloomFilter() {
+    free(_words);
+  }
+
+  std::size_t blocks() const { return std::size_t(1) << _block_bits; }
+  std::size_t block(std::size_t hash) const {
+    return remix(hash) >> (64 - _block_bits);
+  }
+
+  void insert(std::size_t hash) {
+    uint64_t* words = _words + block(hash) * kWordsPerBlock;
+    uint64_t bits = probes(hash);
+    for (int i = 0; i < kProbes; i++, bits >>= 9)
+      words[(bits & 511) >> 6] |= uint64_t(1) << (bits & 63);
+  }
+
+  // insert that other threads may run on the same filter at once.
+  void insert_shared(std::size_t hash) {
+    uint64_t* words = _words + block(hash) * kWordsPerBlock;
+    uint64_t bits = probes(hash);
+    for (int i = 0; i < kProbes; i++, bits >>= 9) {
+      __atomic_fetch_or(&words[(bits & 511) >> 6],
+                        uint64_t(1) << (bits & 63), __ATOMIC_RELAXED);
+    }
+  }
+
+  bool may_contain(std::size_t hash) const {
+    const uint64_t* words = _words + block(hash) * kWordsPerBlock;
+    uint64_t bits = probes(hash);
+    for (int i = 0; i < kProbes; i++, bits >>= 9) {
+      if (!(words[(bits & 511) >> 6] & (uint64_t(1) << (bits & 63))))
+        return false;
+    }
+    return true;
+  }
+
+ private:
+  static uint64_t remix(std::size_t hash) {
+    return static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+  }
+
+  // The top remixed bits picked the block; fold them into the low bits and
+  // mix again so the probes are not tied to the block.
+  static uint64_t probes(std::size_t hash) {
+    uint64_t bits = remix(hash);
+    return (bits ^ (bits >> 32)) * 0xC2B2AE3D27D4EB4FULL;
+  }
+
+  uint64_t* _words;
+  int _block_bits;
+};
+
+} // namespace radix_hash
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HASH_AGGREGATE_H
+#define HASH_AGGREGATE_H 1
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "radix_hash.h"
+
+namespace radix_hash {
+
+// Aggregates fold the values of a group into a Result: init() takes the
+// first value, update() every further one.
+template<typename Value>
+struct SumAggregate {
+  typedef Value Result;
+  Result init(const Value& v) const { return v; }
+  void update(Result& acc, const Value& v) const { acc += v; }
+};
+
+template<typename Value>
+struct CountAggregate {
+  typedef std::size_t Result;
+  Result init(const Value&) const { return 1; }
+  void update(Result& acc, const Value&) const { acc++; }
+};
+
+template<typename Value>
+struct MinAggregate {
+  typedef Value Result;
+  Result init(const Value& v) const { return v; }
+  void update(Result& acc, const Value& v) const {
+    if (v < acc)
+      acc = v;
+  }
+};
+
+template<typename Value>
+struct MaxAggregate {
+  typedef Value Result;
+  Result init(const Value& v) const { return v; }
+  void update(Result& acc, const Value& v) const {
+    if (acc < v)
+      acc = v;
+  }
+};
+
+// Appends a (key, result) to groups for every run of equal keys in
+// dst[begin, end), which is sorted by hash, then key.
+template<typename RandomAccessIterator, typename Aggregate, typename Group>
+void reduce_runs(RandomAccessIterator dst,
+                 std::size_t begin,
+                 std::size_t end,
+                 const Aggregate& agg,
+                 std::vector<Group>* groups) {
+  std::size_t run;
+  while (begin < end) {
+    groups->emplace_back(std::get<1>(dst[begin]),
+                         agg.init(std::get<2>(dst[begin])));
+    for (run = begin + 1; run < end &&
+           std::get<0>(dst[run]) == std::get<0>(dst[begin]) &&
+           std::get<1>(dst[run]) == std::get<1>(dst[begin]); run++)
+      agg.update(groups->back().second, std::get<2>(dst[run]));
+    begin = run;
+  }
+}
+
+} // namespace radix_hash
+
+// GROUP BY over (key, value) pairs without a hash table: the pairs are
+// hash sorted by radix_non_inplace_par, and each leaf range of its last
+// level is reduced by the thread that just sorted it, while it is still
+// in cache. Groups come out in no particular order.
+template<typename Iter, typename Aggregate>
+class HashSortAggregate {
+  typedef typename Iter::value_type::first_type Key;
+  typedef typename Iter::value_type::second_type Value;
+  typedef typename Aggregate::Result Result;
+  typedef std::tuple<std::size_t, Key, Value> HashTuple;
+
+ public:
+  typedef std::pair<Key, Result> Group;
+  typedef typename std::vector<Group>::const_iterator const_iterator;
+
+  HashSortAggregate() = default;
+  HashSortAggregate(Iter begin, Iter end,
+                    unsigned int num_threads = 1,
+                    Aggregate agg = Aggregate()) {
+    std::size_t input_num = std::distance(begin, end), groups_num = 0;
+    int threads = radix_hash::tuned_threads(num_threads, input_num);
+    std::vector<HashTuple> sorted(input_num);
+    std::vector<std::vector<Group>> groups(threads);
+    auto sorted_begin = sorted.begin();
+
+    radix_hash::radix_non_inplace_par<Key, Value, std::hash<Key>>(
+        begin, end, sorted_begin, nullptr, threads,
+        radix_hash::optimal_partition(input_num), radix_hash::kScatterDirect,
+        [&](int thread_id, std::size_t l_begin, std::size_t l_end) {
+          radix_hash::reduce_runs(sorted_begin, l_begin, l_end, agg,
+                                  &groups[thread_id]);
+        });
+
+    for (auto&& g : groups)
+      groups_num += g.size();
+    _groups.reserve(groups_num);
+    for (auto&& g : groups) {
+      std::move(g.begin(), g.end(), std::back_inserter(_groups));
+      std::vector<Group>().swap(g);
+    }
+  }
+
+  const_iterator begin() const { return _groups.begin(); }
+  const_iterator end() const { return _groups.end(); }
+  std::size_t size() const { return _groups.size(); }
+
+ private:
+  std::vector<Group> _groups;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hash_aggregate.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, uint64_t>> KeyValVec;
+
+template<typename Aggregate>
+std::map<std::string, typename Aggregate::Result>
+group_by(const KeyValVec& input) {
+  std::map<std::string, typename Aggregate::Result> groups;
+  Aggregate agg;
+  for (auto&& kv : input) {
+    auto it = groups.find(kv.first);
+    if (it == groups.end())
+      groups.emplace(kv.first, agg.init(kv.second));
+    else
+      agg.update(it->second, kv.second);
+  }
+  return groups;
+}
+
+template<typename Aggregate>
+void check_aggregate(const KeyValVec& input, unsigned int num_threads) {
+  HashSortAggregate<KeyValVec::const_iterator, Aggregate>
+    agg(input.cbegin(), input.cend(), num_threads);
+  std::map<std::string, typename Aggregate::Result> groups;
+  for (auto&& g : agg)
+    EXPECT_TRUE(groups.insert(g).second) << "group split: " << g.first;
+  EXPECT_EQ(group_by<Aggregate>(input), groups);
+}
+
+TEST(hash_aggregate_test, matches_map) {
+  std::default_random_engine generator;
+  for (int size : {0, 1, 100, 50000}) {
+    KeyValVec input;
+    // Few keys, so groups span whole sort buckets, and many keys.
+    for (int distinct : {10, size}) {
+      std::uniform_int_distribution<int> key(0, std::max(distinct, 1));
+      std::uniform_int_distribution<uint64_t> value(0, 1000);
+      input.clear();
+      for (int i = 0; i < size; i++)
+        input.push_back(std::make_pair(std::to_string(key(generator)),
+                                       value(generator)));
+      for (unsigned int threads : {1, 4}) {
+        check_aggregate<radix_hash::SumAggregate<uint64_t>>(input, threads);
+        check_aggregate<radix_hash::CountAggregate<uint64_t>>(input, threads);
+        check_aggregate<radix_hash::MinAggregate<uint64_t>>(input, threads);
+        check_aggregate<radix_hash::MaxAggregate<uint64_t>>(input, threads);
+      }
+    }
+  }
+}
+
+template<typename Aggregate, typename Vec>
+void check_unordered(const Vec& input, unsigned int num_threads) {
+  typedef typename Vec::value_type::first_type Key;
+  typedef std::unordered_map<Key, typename Aggregate::Result> Groups;
+  Groups expected, got;
+  Aggregate agg;
+  for (auto&& kv : input) {
+    auto it = expected.find(kv.first);
+    if (it == expected.end())
+      expected.emplace(kv.first, agg.init(kv.second));
+    else
+      agg.update(it->second, kv.second);
+  }
+  HashSortAggregate<typename Vec::const_iterator, Aggregate>
+    sorted(input.cbegin(), input.cend(), num_threads);
+  for (auto&& g : sorted)
+    EXPECT_TRUE(got.insert(g).second) << "group split: " << g.first;
+  EXPECT_EQ(expected.size(), sorted.size());
+  EXPECT_EQ(expected, got);
+}
+
+template<typename Vec>
+void check_all(const Vec& input, unsigned int num_threads) {
+  typedef typename Vec::value_type::second_type Value;
+  check_unordered<radix_hash::SumAggregate<Value>>(input, num_threads);
+  check_unordered<radix_hash::CountAggregate<Value>>(input, num_threads);
+  check_unordered<radix_hash::MinAggregate<Value>>(input, num_threads);
+  check_unordered<radix_hash::MaxAggregate<Value>>(input, num_threads);
+}
+
+TEST(hash_aggregate_test, single_item_partitions) {
+  // Far fewer keys than top level partitions, so most partitions hold one
+  // item, which the sort never visits.
+  KeyValVec input;
+  for (int i = 0; i < 40; i++)
+    input.push_back(std::make_pair(std::to_string(i), i * 7));
+  for (unsigned int threads : {1, 3})
+    check_all(input, threads);
+}
+
+TEST(hash_aggregate_test, small_buckets) {
+  // A handful of items per partition, below the insertion sort threshold,
+  // with repeated keys inside a bucket.
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> key(0, 150);
+  std::uniform_int_distribution<uint64_t> value(0, 1000);
+  KeyValVec input;
+  for (int i = 0; i < 300; i++)
+    input.push_back(std::make_pair(std::to_string(key(generator)),
+                                   value(generator)));
+  for (unsigned int threads : {1, 2})
+    check_all(input, threads);
+}
+
+TEST(hash_aggregate_test, runs_across_tasks) {
+  // Four hot keys of 25000 items make partitions larger than the steal
+  // threshold, which split into tasks for other threads. Every thread's
+  // input holds every hot key.
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> cold(0, 20000);
+  std::uniform_int_distribution<uint64_t> value(0, 1 << 20);
+  KeyValVec input;
+  for (int i = 0; i < 200000; i++) {
+    int k = i % 2 == 0 ? i % 8 : cold(generator);
+    input.push_back(std::make_pair(std::to_string(k), value(generator)));
+  }
+  std::shuffle(input.begin(), input.end(), generator);
+  for (unsigned int threads : {2, 4, 7})
+    check_all(input, threads);
+}
+
+TEST(hash_aggregate_test, duplicate_keys_last_level) {
+  // std::hash of an integer is the integer, so every level but the last
+  // leaves these keys in one bucket, and each key repeats far past the
+  // insertion sort threshold.
+  std::vector<std::pair<uint64_t, uint64_t>> input;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> value(0, 1000);
+  for (int i = 0; i < 20000; i++)
+    input.push_back(std::make_pair(i % 5, value(generator)));
+  std::shuffle(input.begin(), input.end(), generator);
+  for (unsigned int threads : {1, 4})
+    check_all(input, threads);
+}
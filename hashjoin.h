@@ -24,13 +24,289 @@
 #include <type_traits>
 #include <functional>
 #include <thread>
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
 #include "radix_hash.h"
+#include "key_prefix.h"
+#include "bloom_filter.h"
+#include "thread_pool.h"
 
 typedef std::vector<std::pair<std::string, uint64_t>> KeyValVec;
 typedef std::vector<std::tuple<std::size_t, std::string, uint64_t>>
   HashKeyValVec;
 
-template<typename RIter, typename SIter>
+// What the join reports, and the fn each mode calls:
+// * kInnerJoin: every matching pair, fn(thread_id, key, r_value, s_value).
+// * kSemiJoin: every R item with a match, fn(thread_id, key, r_value).
+// * kAntiJoin: every R item without one, fn(thread_id, key, r_value).
+// * kLeftOuterJoin: every matching pair and every unmatched R item,
+//   fn(thread_id, key, RValue*, SValue*), SValue* null for the latter.
+// * kFullOuterJoin: kLeftOuterJoin plus every unmatched S item, with a
+//   null RValue*.
+// Semi and anti joins never read an S value.
+enum JoinMode {
+  kInnerJoin,
+  kSemiJoin,
+  kAntiJoin,
+  kLeftOuterJoin,
+  kFullOuterJoin,
+};
+
+// [first, last) of the items of a hash sorted range whose top
+// partition_bits hash bits equal partition.
+template<typename Iter>
+std::pair<Iter, Iter> hash_partition_range(Iter begin, Iter end,
+                                           int partition_bits,
+                                           int partition) {
+  typedef typename std::iterator_traits<Iter>::value_type Item;
+  int shift = 64 - partition_bits;
+  std::size_t p = partition;
+  auto before = [shift, p](const Item& item) {
+    return shift < 64 && (std::get<0>(item) >> shift) < p;
+  };
+  auto within = [shift, p](const Item& item) {
+    return shift >= 64 || (std::get<0>(item) >> shift) <= p;
+  };
+  Iter first = std::partition_point(begin, end, before);
+  return std::make_pair(first, std::partition_point(first, end, within));
+}
+
+// Calls fn(thread_id, key, r_value, s_value) for every pair of R and S
+// items with equal keys, both ranges sorted by hash, then key. Each run of
+// equal keys yields its full cross product.
+template<typename RSortedIter, typename SSortedIter, typename Function>
+void merge_matches(RSortedIter r_iter, RSortedIter r_end,
+                   SSortedIter s_iter, SSortedIter s_end,
+                   int thread_id, Function& fn) {
+  RSortedIter r_run;
+  SSortedIter s_run;
+  while (r_iter != r_end && s_iter != s_end) {
+    if (std::get<0>(*r_iter) < std::get<0>(*s_iter)) {
+      r_iter++;
+      continue;
+    }
+    if (std::get<0>(*s_iter) < std::get<0>(*r_iter)) {
+      s_iter++;
+      continue;
+    }
+    if (std::get<1>(*r_iter) < std::get<1>(*s_iter)) {
+      r_iter++;
+      continue;
+    }
+    if (std::get<1>(*s_iter) < std::get<1>(*r_iter)) {
+      s_iter++;
+      continue;
+    }
+    r_run = r_iter + 1;
+    while (r_run != r_end && std::get<0>(*r_run) == std::get<0>(*r_iter) &&
+           std::get<1>(*r_run) == std::get<1>(*r_iter))
+      r_run++;
+    s_run = s_iter + 1;
+    while (s_run != s_end && std::get<0>(*s_run) == std::get<0>(*s_iter) &&
+           std::get<1>(*s_run) == std::get<1>(*s_iter))
+      s_run++;
+    for (RSortedIter r = r_iter; r != r_run; ++r) {
+      for (SSortedIter s = s_iter; s != s_run; ++s) {
+        fn(thread_id, radix_hash::plain_key(std::get<1>(*r)),
+           std::get<2>(*r), std::get<2>(*s));
+      }
+    }
+    r_iter = r_run;
+    s_iter = s_run;
+  }
+}
+
+// First item at or after iter whose hash is not below hash. Gallops, so a
+// whole run of hashes missing from the other side is passed in one step.
+template<typename Iter>
+Iter skip_below_hash(Iter iter, Iter end, std::size_t hash) {
+  typedef typename std::iterator_traits<Iter>::value_type Item;
+  typename std::iterator_traits<Iter>::difference_type step = 1;
+  Iter bound = iter, last;
+  while (end - bound > step && std::get<0>(*(bound + step)) < hash) {
+    bound += step;
+    step *= 2;
+  }
+  last = end - bound > step ? bound + step + 1 : end;
+  return std::partition_point(bound, last, [hash](const Item& item) {
+      return std::get<0>(item) < hash;
+    });
+}
+
+// Semi join, or with Anti the anti join, of two ranges sorted by hash,
+// then key: calls fn(thread_id, key, r_value) for the R items that do, or
+// do not, have an equal S key.
+template<bool Anti, typename RSortedIter, typename SSortedIter,
+  typename Function>
+void merge_filter(RSortedIter r_iter, RSortedIter r_end,
+                  SSortedIter s_iter, SSortedIter s_end,
+                  int thread_id, Function& fn) {
+  RSortedIter r_next;
+  std::size_t h;
+  while (r_iter != r_end) {
+    if (s_iter == s_end) {
+      r_next = r_end;
+    } else if (std::get<0>(*r_iter) < std::get<0>(*s_iter)) {
+      r_next = skip_below_hash(r_iter, r_end, std::get<0>(*s_iter));
+    } else if (std::get<0>(*s_iter) < std::get<0>(*r_iter)) {
+      s_iter = skip_below_hash(s_iter, s_end, std::get<0>(*r_iter));
+      continue;
+    } else if (std::get<1>(*s_iter) < std::get<1>(*r_iter)) {
+      s_iter++;
+      continue;
+    } else if (std::get<1>(*r_iter) < std::get<1>(*s_iter)) {
+      r_next = r_iter + 1;
+    } else {
+      // The whole R run of this key matches.
+      h = std::get<0>(*r_iter);
+      r_next = r_iter + 1;
+      while (r_next != r_end && std::get<0>(*r_next) == h &&
+             std::get<1>(*r_next) == std::get<1>(*r_iter))
+        r_next++;
+      for (; !Anti && r_iter != r_next; ++r_iter) {
+        fn(thread_id, radix_hash::plain_key(std::get<1>(*r_iter)),
+           std::get<2>(*r_iter));
+      }
+      r_iter = r_next;
+      continue;
+    }
+    // [r_iter, r_next) has no match.
+    for (; Anti && r_iter != r_next; ++r_iter) {
+      fn(thread_id, radix_hash::plain_key(std::get<1>(*r_iter)),
+         std::get<2>(*r_iter));
+    }
+    r_iter = r_next;
+  }
+}
+
+// Left outer join, or with Full the full outer join, of two ranges sorted
+// by hash, then key.
+template<bool Full, typename RSortedIter, typename SSortedIter,
+  typename Function>
+void merge_outer(RSortedIter r_iter, RSortedIter r_end,
+                 SSortedIter s_iter, SSortedIter s_end,
+                 int thread_id, Function& fn) {
+  typedef typename std::remove_reference<
+    decltype(std::get<2>(*r_iter))>::type RValue;
+  typedef typename std::remove_reference<
+    decltype(std::get<2>(*s_iter))>::type SValue;
+  RSortedIter r_run;
+  SSortedIter s_run;
+  bool r_first;
+  while (r_iter != r_end || s_iter != s_end) {
+    if (s_iter == s_end) {
+      r_first = true;
+    } else if (r_iter == r_end) {
+      r_first = false;
+    } else if (std::get<0>(*r_iter) != std::get<0>(*s_iter)) {
+      r_first = std::get<0>(*r_iter) < std::get<0>(*s_iter);
+    } else if (std::get<1>(*r_iter) < std::get<1>(*s_iter)) {
+      r_first = true;
+    } else if (std::get<1>(*s_iter) < std::get<1>(*r_iter)) {
+      r_first = false;
+    } else {
+      r_run = r_iter + 1;
+      while (r_run != r_end && std::get<0>(*r_run) == std::get<0>(*r_iter) &&
+             std::get<1>(*r_run) == std::get<1>(*r_iter))
+        r_run++;
+      s_run = s_iter + 1;
+      while (s_run != s_end && std::get<0>(*s_run) == std::get<0>(*s_iter) &&
+             std::get<1>(*s_run) == std::get<1>(*s_iter))
+        s_run++;
+      for (RSortedIter r = r_iter; r != r_run; ++r) {
+        for (SSortedIter s = s_iter; s != s_run; ++s) {
+          fn(thread_id, radix_hash::plain_key(std::get<1>(*r)),
+             &std::get<2>(*r), &std::get<2>(*s));
+        }
+      }
+      r_iter = r_run;
+      s_iter = s_run;
+      continue;
+    }
+    if (r_first) {
+      fn(thread_id, radix_hash::plain_key(std::get<1>(*r_iter)),
+         &std::get<2>(*r_iter), static_cast<SValue*>(nullptr));
+      r_iter++;
+    } else {
+      if (Full) {
+        fn(thread_id, radix_hash::plain_key(std::get<1>(*s_iter)),
+           static_cast<RValue*>(nullptr), &std::get<2>(*s_iter));
+      }
+      s_iter++;
+    }
+  }
+}
+
+template<typename RSortedIter, typename SSortedIter, typename Function>
+void merge_partition(std::integral_constant<JoinMode, kInnerJoin>,
+                     RSortedIter r_iter, RSortedIter r_end,
+                     SSortedIter s_iter, SSortedIter s_end,
+                     int thread_id, Function& fn) {
+  merge_matches(r_iter, r_end, s_iter, s_end, thread_id, fn);
+}
+
+template<typename RSortedIter, typename SSortedIter, typename Function>
+void merge_partition(std::integral_constant<JoinMode, kSemiJoin>,
+                     RSortedIter r_iter, RSortedIter r_end,
+                     SSortedIter s_iter, SSortedIter s_end,
+                     int thread_id, Function& fn) {
+  merge_filter<false>(r_iter, r_end, s_iter, s_end, thread_id, fn);
+}
+
+template<typename RSortedIter, typename SSortedIter, typename Function>
+void merge_partition(std::integral_constant<JoinMode, kAntiJoin>,
+                     RSortedIter r_iter, RSortedIter r_end,
+                     SSortedIter s_iter, SSortedIter s_end,
+                     int thread_id, Function& fn) {
+  merge_filter<true>(r_iter, r_end, s_iter, s_end, thread_id, fn);
+}
+
+template<typename RSortedIter, typename SSortedIter, typename Function>
+void merge_partition(std::integral_constant<JoinMode, kLeftOuterJoin>,
+                     RSortedIter r_iter, RSortedIter r_end,
+                     SSortedIter s_iter, SSortedIter s_end,
+                     int thread_id, Function& fn) {
+  merge_outer<false>(r_iter, r_end, s_iter, s_end, thread_id, fn);
+}
+
+template<typename RSortedIter, typename SSortedIter, typename Function>
+void merge_partition(std::integral_constant<JoinMode, kFullOuterJoin>,
+                     RSortedIter r_iter, RSortedIter r_end,
+                     SSortedIter s_iter, SSortedIter s_end,
+                     int thread_id, Function& fn) {
+  merge_outer<true>(r_iter, r_end, s_iter, s_end, thread_id, fn);
+}
+
+// Joins every partition of two hash sorted ranges in Mode, the partitions
+// handed out to the threads one at a time.
+template<JoinMode Mode, typename RSortedIter, typename SSortedIter,
+  typename Function>
+void merge_partitions_par(RSortedIter r_begin, RSortedIter r_end,
+                          SSortedIter s_begin, SSortedIter s_end,
+                          int partition_bits, Function fn,
+                          ThreadPool* pool, int num_threads) {
+  std::atomic_int next_partition(0);
+  int partitions = 1 << partition_bits;
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::pair<RSortedIter, RSortedIter> r_range;
+      std::pair<SSortedIter, SSortedIter> s_range;
+      int p = next_partition.fetch_add(1, std::memory_order_relaxed);
+      while (p < partitions) {
+        r_range = hash_partition_range(r_begin, r_end, partition_bits, p);
+        s_range = hash_partition_range(s_begin, s_end, partition_bits, p);
+        merge_partition(std::integral_constant<JoinMode, Mode>(),
+                        r_range.first, r_range.second,
+                        s_range.first, s_range.second, thread_id, fn);
+        p = next_partition.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+}
+
+// KeyPrefix stores radix_hash::PrefixedKey in the sorted tuples, so equal
+// hash runs are mostly resolved by the cached prefix instead of the key.
+template<typename RIter, typename SIter, bool KeyPrefix = false>
 class HashMergeJoin {
   static_assert(std::is_same<
                 typename RIter::value_type::first_type,
@@ -45,26 +321,55 @@ class HashMergeJoin {
   typedef typename RIter::value_type::first_type Key;
   typedef typename RIter::value_type::second_type RValue;
   typedef typename SIter::value_type::second_type SValue;
-  typedef typename std::tuple<std::size_t, Key, RValue> RTuple;
-  typedef typename std::tuple<std::size_t, Key, SValue> STuple;
+  typedef typename std::conditional<KeyPrefix,
+    radix_hash::PrefixedKey<Key>, Key>::type SortKey;
+  typedef typename std::tuple<std::size_t, SortKey, RValue> RTuple;
+  typedef typename std::tuple<std::size_t, SortKey, SValue> STuple;
   typedef typename std::vector<RTuple>::iterator RSortedIter;
   typedef typename std::vector<STuple>::iterator SSortedIter;
 
   //protected:
  public:
   HashMergeJoin() = default;
+  // bloom_filter drops the S items whose hash is not in a Bloom filter of
+  // the R hashes before S is sorted, which pays off when few S items
+  // match. Such a join throws std::logic_error on kFullOuterJoin.
   HashMergeJoin(RIter r_begin, RIter r_end,
                 SIter s_begin, SIter s_end,
-                unsigned int num_threads = 1)  {
+                unsigned int num_threads = 1,
+                bool bloom_filter = false)  {
     distance_type r_size, s_size;
     r_size = std::distance(r_begin, r_end);
     s_size = std::distance(s_begin, s_end);
-    _r_sorted = std::vector<std::tuple<std::size_t, Key, RValue>>(r_size);
-    _s_sorted = std::vector<std::tuple<std::size_t, Key, SValue>>(s_size);
+    _r_sorted = std::vector<RTuple>(r_size);
+    // Both sides partition on the same top hash bits, so partition p of R
+    // only ever joins partition p of S.
+    _partition_bits = radix_hash::optimal_partition(std::max(r_size, s_size));
 
-    radix_hash::radix_non_inplace_par<Key, RValue>(r_begin, r_end, _r_sorted.begin(), num_threads);
-
-    radix_hash::radix_non_inplace_par<Key, SValue>(s_begin, s_end, _s_sorted.begin(), num_threads);
+    if (bloom_filter) {
+      int threads = radix_hash::tuned_threads(num_threads, r_size + s_size);
+      // R's hashes go into the filter while R is counted for its scatter.
+      radix_hash::BlockedBloomFilter filter(r_size);
+      radix_hash::radix_non_inplace_par<SortKey, RValue, std::hash<Key>>(
+          r_begin, r_end, _r_sorted.begin(), nullptr, threads,
+          _partition_bits, radix_hash::kScatterDirect,
+          radix_hash::IgnoreLeaves(),
+          [&filter](std::size_t h) { filter.insert_shared(h); });
+      std::vector<std::vector<HashedSItem>> s_kept =
+        filter_s(s_begin, s_end, filter, threads);
+      std::size_t kept_size = 0;
+      for (auto&& run : s_kept)
+        kept_size += run.size();
+      _s_sorted = std::vector<STuple>(kept_size);
+      _s_filtered = true;
+      radix_hash::radix_non_inplace_runs<SortKey, SValue,
+                                         radix_hash::Prehashed>(
+          &s_kept, _s_sorted.begin(), nullptr, _partition_bits);
+      return;
+    }
+    radix_hash::radix_non_inplace_par<SortKey, RValue, std::hash<Key>>(r_begin, r_end, _r_sorted.begin(), num_threads, _partition_bits);
+    _s_sorted = std::vector<STuple>(s_size);
+    radix_hash::radix_non_inplace_par<SortKey, SValue, std::hash<Key>>(s_begin, s_end, _s_sorted.begin(), num_threads, _partition_bits);
   }
 
   class iterator : std::iterator<std::input_iterator_tag,
@@ -166,7 +471,7 @@ class HashMergeJoin {
       return _rs_iter != other._rs_iter || _ss_iter != other._ss_iter;
     }
     std::tuple<Key*, RValue*, SValue*>& operator*() {
-      tmp_val = std::make_tuple(&std::get<1>(*_rs_iter),
+      tmp_val = std::make_tuple(&radix_hash::plain_key(std::get<1>(*_rs_iter)),
                                 &std::get<2>(*_rs_iter),
                                 &std::get<2>(*_ss_iter));
       return tmp_val;
@@ -189,13 +494,101 @@ class HashMergeJoin {
     return iterator(_r_sorted.end(), _r_sorted.end(),
                     _s_sorted.end(), _s_sorted.end());
   }
+
+  // The join splits into partitions() independent sub-joins on the top
+  // hash bits; begin(p), end(p) walk the matches of partition p.
+  int partitions() const { return 1 << _partition_bits; }
+
+  iterator begin(int partition) {
+    auto r = hash_partition_range(_r_sorted.begin(), _r_sorted.end(),
+                                  _partition_bits, partition);
+    auto s = hash_partition_range(_s_sorted.begin(), _s_sorted.end(),
+                                  _partition_bits, partition);
+    return iterator(r.first, r.second, s.first, s.second);
+  }
+
+  iterator end(int partition) {
+    auto r = hash_partition_range(_r_sorted.begin(), _r_sorted.end(),
+                                  _partition_bits, partition);
+    auto s = hash_partition_range(_s_sorted.begin(), _s_sorted.end(),
+                                  _partition_bits, partition);
+    return iterator(r.second, r.second, s.second, s.second);
+  }
+
+  // Reports the join in Mode (see JoinMode) through fn, with the
+  // partitions merged concurrently on num_threads threads.
+  template<JoinMode Mode, typename Function>
+  void for_each(Function fn, int num_threads) {
+    check_mode(Mode);
+    merge_partitions_par<Mode>(_r_sorted.begin(), _r_sorted.end(),
+                               _s_sorted.begin(), _s_sorted.end(),
+                               _partition_bits, fn, nullptr,
+                               radix_hash::tuned_threads(
+                                   num_threads,
+                                   _r_sorted.size() + _s_sorted.size()));
+  }
+
+  template<JoinMode Mode, typename Function>
+  void for_each(Function fn, ThreadPool& pool) {
+    check_mode(Mode);
+    merge_partitions_par<Mode>(_r_sorted.begin(), _r_sorted.end(),
+                               _s_sorted.begin(), _s_sorted.end(),
+                               _partition_bits, fn, &pool, pool.size());
+  }
+
+  // Calls fn(thread_id, const Key&, RValue&, SValue&) for every matching
+  // pair. Unlike the iterator, every pair of a many-to-many key is
+  // produced.
+  template<typename Function>
+  void for_each_match(Function fn, int num_threads) {
+    for_each<kInnerJoin>(fn, num_threads);
+  }
+
+  template<typename Function>
+  void for_each_match(Function fn, ThreadPool& pool) {
+    for_each<kInnerJoin>(fn, pool);
+  }
+
   void clear() {
     _r_sorted.clear();
     _s_sorted.clear();
   }
  protected:
-  std::vector<std::tuple<std::size_t, Key, RValue>> _r_sorted;
-  std::vector<std::tuple<std::size_t, Key, SValue>> _s_sorted;
+  typedef std::tuple<std::size_t, Key, SValue> HashedSItem;
+
+  // The filter already dropped the S items a full outer join must report.
+  void check_mode(JoinMode mode) const {
+    if (mode == kFullOuterJoin && _s_filtered)
+      throw std::logic_error("kFullOuterJoin on a Bloom filtered join");
+  }
+
+  // Hashes S and keeps the items filter may contain, each thread a chunk
+  // of S into a run of its own, as prehashed input for the S sort.
+  std::vector<std::vector<HashedSItem>> filter_s(
+      SIter s_begin, SIter s_end,
+      const radix_hash::BlockedBloomFilter& filter, int num_threads) {
+    std::vector<std::vector<HashedSItem>> kept(num_threads);
+    distance_type thread_partition =
+      std::distance(s_begin, s_end) / num_threads;
+
+    run_on_threads(nullptr, num_threads, [&](int thread_id) {
+        std::size_t h;
+        SIter t_begin = s_begin + thread_id * thread_partition;
+        SIter t_end = thread_id == num_threads - 1 ?
+          s_end : s_begin + (thread_id + 1) * thread_partition;
+        for (; t_begin != t_end; ++t_begin) {
+          h = std::hash<Key>{}(t_begin->first);
+          if (filter.may_contain(h))
+            kept[thread_id].emplace_back(h, t_begin->first, t_begin->second);
+        }
+      });
+    return kept;
+  }
+
+  std::vector<RTuple> _r_sorted;
+  std::vector<STuple> _s_sorted;
+  int _partition_bits = 0;
+  bool _s_filtered = false;
 };
 
 template<typename RIter, typename SIter>
@@ -230,9 +623,12 @@ class HashMergeJoin2 {
 
     r_size = std::distance(r_begin, r_end);
     s_size = std::distance(s_begin, s_end);
+    _partition_bits = radix_hash::optimal_partition(std::max(r_size, s_size));
 
-    radix_hash::radix_inplace_par(_r_begin, r_size, num_threads);
-    radix_hash::radix_inplace_par(_s_begin, s_size, num_threads);
+    radix_hash::radix_inplace_par(_r_begin, r_size, num_threads,
+                                  _partition_bits);
+    radix_hash::radix_inplace_par(_s_begin, s_size, num_threads,
+                                  _partition_bits);
   }
 
   class iterator : std::iterator<std::input_iterator_tag,
@@ -355,10 +751,282 @@ class HashMergeJoin2 {
   iterator end() {
     return iterator(_r_end, _r_end, _s_end, _s_end);
   }
+
+  // Same partition split as HashMergeJoin.
+  int partitions() const { return 1 << _partition_bits; }
+
+  iterator begin(int partition) {
+    auto r = hash_partition_range(_r_begin, _r_end, _partition_bits,
+                                  partition);
+    auto s = hash_partition_range(_s_begin, _s_end, _partition_bits,
+                                  partition);
+    return iterator(r.first, r.second, s.first, s.second);
+  }
+
+  iterator end(int partition) {
+    auto r = hash_partition_range(_r_begin, _r_end, _partition_bits,
+                                  partition);
+    auto s = hash_partition_range(_s_begin, _s_end, _partition_bits,
+                                  partition);
+    return iterator(r.second, r.second, s.second, s.second);
+  }
+
+  template<JoinMode Mode, typename Function>
+  void for_each(Function fn, int num_threads) {
+    merge_partitions_par<Mode>(_r_begin, _r_end, _s_begin, _s_end,
+                               _partition_bits, fn, nullptr,
+                               radix_hash::tuned_threads(
+                                   num_threads,
+                                   std::distance(_r_begin, _r_end) +
+                                   std::distance(_s_begin, _s_end)));
+  }
+
+  template<JoinMode Mode, typename Function>
+  void for_each(Function fn, ThreadPool& pool) {
+    merge_partitions_par<Mode>(_r_begin, _r_end, _s_begin, _s_end,
+                               _partition_bits, fn, &pool, pool.size());
+  }
+
+  template<typename Function>
+  void for_each_match(Function fn, int num_threads) {
+    for_each<kInnerJoin>(fn, num_threads);
+  }
+
+  template<typename Function>
+  void for_each_match(Function fn, ThreadPool& pool) {
+    for_each<kInnerJoin>(fn, pool);
+  }
  protected:
   RIter _r_begin;
   RIter _r_end;
   SIter _s_begin;
   SIter _s_end;
+  int _partition_bits = 0;
+};
+
+// Joins without sorting: R, the build side, and S are only scattered on
+// their top hash bits into partitions sized for the cache, then every R
+// partition gets a linear probing table of slot indexes that the matching
+// S partition probes. Suits a small R joined to a large S.
+template<typename RIter, typename SIter>
+class RadixHashJoin {
+  static_assert(std::is_same<
+                typename RIter::value_type::first_type,
+                typename SIter::value_type::first_type>::value,
+                "RIter and SIter key type must be the same");
+  static_assert(std::is_same<
+                typename RIter::difference_type,
+                typename SIter::difference_type>::value,
+                "RIter and SIter difference type must be the same");
+
+  typedef typename RIter::difference_type distance_type;
+  typedef typename RIter::value_type::first_type Key;
+  typedef typename RIter::value_type::second_type RValue;
+  typedef typename SIter::value_type::second_type SValue;
+  typedef typename std::tuple<std::size_t, Key, RValue> RTuple;
+  typedef typename std::tuple<std::size_t, Key, SValue> STuple;
+  typedef std::vector<std::pair<std::size_t, std::size_t>> Indexes;
+
+  // Widest fan-out of one partition pass; past it the scatter's write
+  // lines and pages no longer fit the L1 cache and the TLB.
+  static const int kMaxPassBits = 12;
+  // Used when the L2 size cannot be detected.
+  static const std::size_t kDefaultCacheBytes = 256 << 10;
+
+ public:
+  RadixHashJoin() = default;
+  // Partitions R so that a partition and its table fit cache_bytes, by
+  // default the detected L2 cache, in one partition pass per kMaxPassBits
+  // partition bits.
+  RadixHashJoin(RIter r_begin, RIter r_end,
+                SIter s_begin, SIter s_end,
+                unsigned int num_threads = 1,
+                std::size_t cache_bytes = 0) {
+    distance_type r_size, s_size;
+    int threads;
+    r_size = std::distance(r_begin, r_end);
+    s_size = std::distance(s_begin, s_end);
+    _r_partitioned = std::vector<RTuple>(r_size);
+    _s_partitioned = std::vector<STuple>(s_size);
+    if (cache_bytes == 0)
+      cache_bytes = radix_hash::detect_cache_size(2);
+    if (cache_bytes == 0)
+      cache_bytes = kDefaultCacheBytes;
+    threads = radix_hash::tuned_threads(num_threads, r_size + s_size);
+    // Sized by the build side, whose partitions must stay in cache. A
+    // table has about two slots per item. The partition pass needs at
+    // least one bit.
+    _partition_bits = 1;
+    while ((r_size * (sizeof(RTuple) + 2 * sizeof(uint32_t)) >>
+            _partition_bits) > cache_bytes &&
+           _partition_bits < 2 * kMaxPassBits)
+      _partition_bits++;
+    while ((1 << _partition_bits) < threads &&
+           _partition_bits < kMaxPassBits)
+      _partition_bits++;
+
+    if (_partition_bits <= kMaxPassBits) {
+      radix_hash::radix_partition_par<Key, RValue, std::hash<Key>>(
+          r_begin, r_end, _r_partitioned.begin(), threads, _partition_bits,
+          &_r_indexes);
+      radix_hash::radix_partition_par<Key, SValue, std::hash<Key>>(
+          s_begin, s_end, _s_partitioned.begin(), threads, _partition_bits,
+          &_s_indexes);
+    } else {
+      int first_bits = (_partition_bits + 1) / 2;
+      std::vector<RTuple> r_first(r_size);
+      std::vector<STuple> s_first(s_size);
+      Indexes r_first_indexes, s_first_indexes;
+      radix_hash::radix_partition_par<Key, RValue, std::hash<Key>>(
+          r_begin, r_end, r_first.begin(), threads, first_bits,
+          &r_first_indexes);
+      radix_hash::radix_partition_par<Key, SValue, std::hash<Key>>(
+          s_begin, s_end, s_first.begin(), threads, first_bits,
+          &s_first_indexes);
+      second_pass(r_first, r_first_indexes, first_bits, threads,
+                  &_r_partitioned, &_r_indexes);
+      second_pass(s_first, s_first_indexes, first_bits, threads,
+                  &_s_partitioned, &_s_indexes);
+    }
+    build(threads);
+  }
+
+  int partitions() const { return 1 << _partition_bits; }
+
+  // Calls fn(thread_id, const Key&, RValue&, SValue&) for every matching
+  // pair, with the S partitions probed concurrently on num_threads threads.
+  template<typename Function>
+  void for_each_match(Function fn, int num_threads) {
+    probe(fn, nullptr, radix_hash::tuned_threads(
+              num_threads, _r_partitioned.size() + _s_partitioned.size()));
+  }
+
+  template<typename Function>
+  void for_each_match(Function fn, ThreadPool& pool) {
+    probe(fn, &pool, pool.size());
+  }
+
+  void clear() {
+    _r_partitioned.clear();
+    _s_partitioned.clear();
+    _r_indexes.clear();
+    _s_indexes.clear();
+    _slots.clear();
+    _slot_offsets.clear();
+  }
+
+ protected:
+  // Runs fn(thread_id, partition) on every one of partitions, handed out
+  // to the threads one at a time.
+  template<typename Function>
+  static void partitions_par(ThreadPool* pool, int num_threads,
+                             int partitions, Function fn) {
+    std::atomic_int next_partition(0);
+    run_on_threads(pool, num_threads, [&](int thread_id) {
+        int p = next_partition.fetch_add(1, std::memory_order_relaxed);
+        while (p < partitions) {
+          fn(thread_id, p);
+          p = next_partition.fetch_add(1, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  // Scatters each partition of src, grouped by its top first_bits hash
+  // bits, on the next _partition_bits - first_bits bits into the same range
+  // of dst, one partition per task.
+  template<typename Tuple>
+  void second_pass(std::vector<Tuple>& src, const Indexes& src_indexes,
+                   int first_bits, int num_threads, std::vector<Tuple>* dst,
+                   Indexes* indexes) {
+    int bits = _partition_bits - first_bits;
+    std::size_t fan_out = std::size_t(1) << bits;
+    indexes->resize(std::size_t(1) << _partition_bits);
+    partitions_par(nullptr, num_threads, 1 << first_bits, [&](int, int p) {
+        std::size_t first = src_indexes[p].first;
+        std::size_t last = src_indexes[p].second;
+        std::pair<std::size_t, std::size_t>* sub =
+          &(*indexes)[p * fan_out];
+        std::vector<std::size_t> offsets(fan_out, 0);
+        auto digit = [first_bits, bits](const Tuple& t) {
+          return (std::get<0>(t) << first_bits) >> (64 - bits);
+        };
+        for (std::size_t i = first; i < last; i++)
+          offsets[digit(src[i])]++;
+        for (std::size_t d = 0, pos = first; d < fan_out; d++) {
+          sub[d].first = pos;
+          pos += offsets[d];
+          sub[d].second = pos;
+          offsets[d] = sub[d].first;
+        }
+        for (std::size_t i = first; i < last; i++)
+          (*dst)[offsets[digit(src[i])]++] = std::move(src[i]);
+      });
+  }
+
+  // Tables are a power of two of slots, at least twice the partition size.
+  // A slot holds 1 + the index of an R item within its partition, 0 marks
+  // it empty; the low hash bits pick the first slot.
+  void build(int num_threads) {
+    std::size_t size, capacity, offset = 0;
+    _slot_offsets.resize(_r_indexes.size() + 1);
+    for (std::size_t p = 0; p < _r_indexes.size(); p++) {
+      size = _r_indexes[p].second - _r_indexes[p].first;
+      capacity = 0;
+      if (size > 0) {
+        capacity = 1;
+        while (capacity < 2 * size)
+          capacity <<= 1;
+      }
+      _slot_offsets[p] = offset;
+      offset += capacity;
+    }
+    _slot_offsets.back() = offset;
+    _slots.assign(offset, 0);
+
+    partitions_par(nullptr, num_threads, partitions(), [this](int, int p) {
+        uint32_t* slots = &_slots[_slot_offsets[p]];
+        std::size_t mask = _slot_offsets[p + 1] - _slot_offsets[p] - 1;
+        std::size_t first = _r_indexes[p].first, slot;
+        for (std::size_t i = first; i < _r_indexes[p].second; i++) {
+          slot = std::get<0>(_r_partitioned[i]) & mask;
+          while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+          slots[slot] = static_cast<uint32_t>(i - first + 1);
+        }
+      });
+  }
+
+  template<typename Function>
+  void probe(Function& fn, ThreadPool* pool, int num_threads) {
+    partitions_par(pool, num_threads, partitions(),
+                   [this, &fn](int thread_id, int p) {
+        const uint32_t* slots = _slots.data() + _slot_offsets[p];
+        std::size_t capacity = _slot_offsets[p + 1] - _slot_offsets[p];
+        std::size_t mask = capacity - 1;
+        std::size_t first = _r_indexes[p].first, h, slot;
+        if (capacity == 0)
+          return;
+        for (std::size_t i = _s_indexes[p].first;
+             i < _s_indexes[p].second; i++) {
+          STuple& s = _s_partitioned[i];
+          h = std::get<0>(s);
+          // Duplicate R keys sit in the same probe run, so keep walking
+          // up to the first empty slot.
+          for (slot = h & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+            RTuple& r = _r_partitioned[first + slots[slot] - 1];
+            if (std::get<0>(r) == h && std::get<1>(r) == std::get<1>(s))
+              fn(thread_id, std::get<1>(r), std::get<2>(r), std::get<2>(s));
+          }
+        }
+      });
+  }
+
+  std::vector<RTuple> _r_partitioned;
+  std::vector<STuple> _s_partitioned;
+  Indexes _r_indexes;
+  Indexes _s_indexes;
+  std::vector<uint32_t> _slots;
+  std::vector<std::size_t> _slot_offsets;
+  int _partition_bits = 0;
 };
 #endif
@@ -19,6 +19,8 @@
 #include <unordered_map>
 #include "radix_hash.h"
 #include "hashjoin.h"
+#include "hash_aggregate.h"
+#include "spill_join.h"
 #include "partitioned_hash.h"
 #include "strgen.h"
 #include <assert.h>
@@ -142,6 +144,179 @@ static void BM_HashMergeJoin(benchmark::State& state) {
   state.SetComplexityN(state.range(0)*2);
 }
 
+// Spills both sides, with a budget of about a quarter of the in memory
+// join's footprint.
+static void BM_SpillingHashJoin(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int num_threads = std::thread::hardware_concurrency();
+  auto r = ::create_strvec(size);
+  auto s = ::create_strvec(size);
+  std::size_t budget = static_cast<std::size_t>(size) * 2 *
+    sizeof(std::tuple<std::size_t, std::string, uint64_t>) / 4;
+  std::vector<uint64_t> sums(num_threads);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    SpillingHashJoin<KeyValVec::iterator,KeyValVec::iterator>
+      shj(r.begin(), r.end(), s.begin(), s.end(), budget, num_threads);
+    std::fill(sums.begin(), sums.end(), 0);
+    shj.for_each_match([&sums](int thread_id, const std::string&,
+                               uint64_t r_val, uint64_t s_val) {
+        sums[thread_id] += r_val + s_val;
+      });
+    benchmark::DoNotOptimize(sums.data());
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0)*2);
+}
+
+static void BM_unordered_map_aggregate(benchmark::State& state) {
+  int size = state.range(0);
+  auto r = ::create_strvec(size);
+  std::unordered_map<std::string, uint64_t> sums;
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    sums.clear();
+    state.ResumeTiming();
+
+    START_COUNTERS;
+    for (auto&& kv : r) {
+      sums[kv.first] += kv.second;
+    }
+    benchmark::DoNotOptimize(sums.size());
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_HashSortAggregate(benchmark::State& state) {
+  int size = state.range(0);
+  auto r = ::create_strvec(size);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    HashSortAggregate<KeyValVec::iterator,
+      radix_hash::SumAggregate<uint64_t>> sums(
+          r.begin(), r.end(), std::thread::hardware_concurrency());
+    benchmark::DoNotOptimize(sums.size());
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+// Builds tables on R partitions and probes them with S, no sorting.
+static void BM_RadixHashJoin(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int num_threads = std::thread::hardware_concurrency();
+  auto r = ::create_strvec(size);
+  auto s = ::create_strvec(size);
+  RadixHashJoin<KeyValVec::iterator,KeyValVec::iterator> rhj;
+  std::vector<uint64_t> sums(num_threads);
+
+  struct rusage u_before, u_after;
+  getrusage(RUSAGE_SELF, &u_before);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    rhj.clear();
+    state.ResumeTiming();
+
+    START_COUNTERS;
+    rhj = RadixHashJoin<KeyValVec::iterator,
+        KeyValVec::iterator>(r.begin(), r.end(),
+            s.begin(), s.end(), num_threads);
+    std::fill(sums.begin(), sums.end(), 0);
+    rhj.for_each_match([&sums](int thread_id, const std::string&,
+                               uint64_t r_val, uint64_t s_val) {
+        sums[thread_id] += r_val + s_val;
+      }, num_threads);
+    benchmark::DoNotOptimize(sums.data());
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+  state.SetComplexityN(state.range(0)*2);
+}
+
+// Same join, with the merge spread over the partitions on every core.
+static void BM_HashMergeJoin_par_merge(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int num_threads = std::thread::hardware_concurrency();
+  auto r = ::create_strvec(size);
+  auto s = ::create_strvec(size);
+  HashMergeJoin<KeyValVec::iterator,KeyValVec::iterator> hmj;
+  std::vector<uint64_t> sums(num_threads);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    hmj.clear();
+    state.ResumeTiming();
+
+    START_COUNTERS;
+    hmj = HashMergeJoin<KeyValVec::iterator,
+        KeyValVec::iterator>(r.begin(), r.end(),
+            s.begin(), s.end(), num_threads);
+    std::fill(sums.begin(), sums.end(), 0);
+    hmj.for_each_match([&sums](int thread_id, const std::string&,
+                               uint64_t r_val, uint64_t s_val) {
+        sums[thread_id] += r_val + s_val;
+      }, num_threads);
+    benchmark::DoNotOptimize(sums.data());
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0)*2);
+}
+
+static void BM_HashMergeJoin_prefix(benchmark::State& state) {
+  int size = state.range(0);
+  uint64_t sum = 0;
+  auto r = ::create_strvec(size);
+  auto s = ::create_strvec(size);
+  HashMergeJoin<KeyValVec::iterator,KeyValVec::iterator,true> hmj;
+
+  struct rusage u_before, u_after;
+  getrusage(RUSAGE_SELF, &u_before);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    hmj.clear();
+    state.ResumeTiming();
+
+    START_COUNTERS;
+    hmj = HashMergeJoin<KeyValVec::iterator,
+        KeyValVec::iterator,true>(r.begin(), r.end(),
+            s.begin(), s.end(),
+            std::thread::hardware_concurrency());
+    sum = 0;
+    for (auto tuple : hmj) {
+      benchmark::DoNotOptimize(sum += *std::get<1>(tuple)+*std::get<2>(tuple));
+    }
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+  state.SetComplexityN(state.range(0)*2);
+}
+
 static void BM_HashMergeJoin_1thread(benchmark::State& state) {
   int size = state.range(0);
   uint64_t sum = 0;
@@ -281,6 +456,12 @@ static void RadixArguments(benchmark::internal::Benchmark* b) {
 BENCHMARK(BM_hash_join_raw)->Apply(RadixArguments);
 BENCHMARK(BM_partitioned_hash_join_raw)->Apply(RadixArguments);
 BENCHMARK(BM_HashMergeJoin)->Apply(RadixArguments);
+BENCHMARK(BM_RadixHashJoin)->Apply(RadixArguments);
+BENCHMARK(BM_HashMergeJoin_par_merge)->Apply(RadixArguments);
+BENCHMARK(BM_HashMergeJoin_prefix)->Apply(RadixArguments);
+BENCHMARK(BM_SpillingHashJoin)->Apply(RadixArguments);
+BENCHMARK(BM_unordered_map_aggregate)->Apply(RadixArguments);
+BENCHMARK(BM_HashSortAggregate)->Apply(RadixArguments);
 
 // BENCHMARK(BM_hash_join_raw)->RangeMultiplier(2)
 // ->Range(1<<18, 1<<24)->Complexity(benchmark::oN)
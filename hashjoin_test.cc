@@ -0,0 +1,252 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hashjoin.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST(hashjoin_test, radix_hash_join_matches) {
+  int size = 20000;
+  KeyValVec r, s;
+  std::default_random_engine generator;
+  // A small dimension R with a few duplicate keys, a larger fact S.
+  std::uniform_int_distribution<int> distribution(0, size / 4);
+  for (int i = 0; i < size / 10; i++)
+    r.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  for (int i = 0; i < size; i++)
+    s.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  std::map<std::string, std::size_t> r_count;
+  std::size_t expected = 0;
+  for (auto&& t : r)
+    r_count[t.first]++;
+  for (auto&& t : s)
+    expected += r_count[t.first];
+
+  // A tiny cache takes more partition bits than one pass scatters.
+  for (std::size_t cache_bytes : {std::size_t(0), std::size_t(8)}) {
+  for (unsigned int threads : {1, 4}) {
+    RadixHashJoin<KeyValVec::iterator, KeyValVec::iterator>
+      join(r.begin(), r.end(), s.begin(), s.end(), threads, cache_bytes);
+    if (cache_bytes) {
+      EXPECT_GT(join.partitions(), 1 << 12);
+    }
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> out(threads);
+    join.for_each_match([&](int thread_id, const std::string& key,
+                            uint64_t r_val, uint64_t s_val) {
+        EXPECT_EQ(r[r_val].first, key);
+        EXPECT_EQ(s[s_val].first, key);
+        out[thread_id].push_back(std::make_pair(r_val, s_val));
+      }, threads);
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (auto&& v : out)
+      pairs.insert(pairs.end(), v.begin(), v.end());
+    std::sort(pairs.begin(), pairs.end());
+    EXPECT_EQ(expected, pairs.size());
+    EXPECT_TRUE(std::unique(pairs.begin(), pairs.end()) == pairs.end());
+  }
+  }
+}
+
+TEST(hashjoin_test, radix_hash_join_empty) {
+  KeyValVec r, s = {{"a", 1}};
+  RadixHashJoin<KeyValVec::iterator, KeyValVec::iterator>
+    join(r.begin(), r.end(), s.begin(), s.end(), 2);
+  std::size_t matches = 0;
+  join.for_each_match([&](int, const std::string&, uint64_t, uint64_t) {
+      matches++;
+    }, 2);
+  EXPECT_EQ(0u, matches);
+}
+
+template<bool KeyPrefix>
+void check_join_modes() {
+  int size = 20000;
+  KeyValVec r, s;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, size / 2);
+  for (int i = 0; i < size / 4; i++)
+    r.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  for (int i = 0; i < size; i++)
+    s.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  std::map<std::string, std::size_t> r_count, s_count;
+  std::size_t semi = 0, anti = 0, inner = 0, s_only = 0;
+  for (auto&& t : r)
+    r_count[t.first]++;
+  for (auto&& t : s)
+    s_count[t.first]++;
+  for (auto&& t : r) {
+    auto it = s_count.find(t.first);
+    if (it == s_count.end()) {
+      anti++;
+    } else {
+      semi++;
+      inner += it->second;
+    }
+  }
+  for (auto&& t : s)
+    s_only += r_count.count(t.first) == 0;
+
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator, KeyPrefix>
+    join(r.begin(), r.end(), s.begin(), s.end(), 4);
+  std::vector<std::vector<uint64_t>> semi_out(4), anti_out(4);
+  join.template for_each<kSemiJoin>(
+      [&](int thread_id, const std::string& key, uint64_t r_val) {
+        EXPECT_EQ(r[r_val].first, key);
+        semi_out[thread_id].push_back(r_val);
+      }, 4);
+  join.template for_each<kAntiJoin>(
+      [&](int thread_id, const std::string& key, uint64_t r_val) {
+        EXPECT_EQ(r[r_val].first, key);
+        EXPECT_EQ(0u, s_count.count(key));
+        anti_out[thread_id].push_back(r_val);
+      }, 4);
+  std::vector<uint64_t> r_vals;
+  std::size_t semi_num = 0;
+  for (int t = 0; t < 4; t++) {
+    semi_num += semi_out[t].size();
+    r_vals.insert(r_vals.end(), semi_out[t].begin(), semi_out[t].end());
+    r_vals.insert(r_vals.end(), anti_out[t].begin(), anti_out[t].end());
+  }
+  std::sort(r_vals.begin(), r_vals.end());
+  EXPECT_EQ(semi, semi_num);
+  EXPECT_EQ(r.size(), r_vals.size());
+  EXPECT_TRUE(std::unique(r_vals.begin(), r_vals.end()) == r_vals.end());
+
+  for (bool full : {false, true}) {
+    std::vector<std::size_t> matched(4, 0), r_missing(4, 0), s_missing(4, 0);
+    auto fn = [&](int thread_id, const std::string& key,
+                  uint64_t* r_val, uint64_t* s_val) {
+      ASSERT_TRUE(r_val || s_val);
+      if (r_val) {
+        EXPECT_EQ(r[*r_val].first, key);
+      }
+      if (s_val) {
+        EXPECT_EQ(s[*s_val].first, key);
+      }
+      if (r_val && s_val)
+        matched[thread_id]++;
+      else if (r_val)
+        r_missing[thread_id]++;
+      else
+        s_missing[thread_id]++;
+    };
+    if (full)
+      join.template for_each<kFullOuterJoin>(fn, 4);
+    else
+      join.template for_each<kLeftOuterJoin>(fn, 4);
+    std::size_t m = 0, rm = 0, sm = 0;
+    for (int t = 0; t < 4; t++) {
+      m += matched[t];
+      rm += r_missing[t];
+      sm += s_missing[t];
+    }
+    EXPECT_EQ(inner, m);
+    EXPECT_EQ(anti, rm);
+    EXPECT_EQ(full ? s_only : 0, sm);
+  }
+}
+
+TEST(hashjoin_test, join_modes) {
+  check_join_modes<false>();
+}
+
+TEST(hashjoin_test, join_modes_prefixed) {
+  check_join_modes<true>();
+}
+
+TEST(hashjoin_test, bloom_filter_no_false_negatives) {
+  std::size_t keys = 10000, hits = 0;
+  radix_hash::BlockedBloomFilter filter(keys);
+  std::hash<std::string> hash;
+  for (std::size_t i = 0; i < keys; i++)
+    filter.insert(hash(std::to_string(i)));
+  for (std::size_t i = 0; i < keys; i++)
+    EXPECT_TRUE(filter.may_contain(hash(std::to_string(i))));
+  for (std::size_t i = keys; i < 11 * keys; i++)
+    hits += filter.may_contain(hash(std::to_string(i)));
+  // About 1% false positives at 10 bits per key.
+  EXPECT_LT(hits, keys / 2);
+}
+
+TEST(hashjoin_test, bloom_filter_integer_keys) {
+  // std::hash of an integer is the integer, so these hashes share their
+  // top bits.
+  std::size_t keys = 10000, hits = 0;
+  radix_hash::BlockedBloomFilter filter(keys);
+  std::hash<uint64_t> hash;
+  for (uint64_t i = 0; i < keys; i++)
+    filter.insert(hash(i));
+  for (uint64_t i = 0; i < keys; i++)
+    EXPECT_TRUE(filter.may_contain(hash(i)));
+  for (uint64_t i = keys; i < 11 * keys; i++)
+    hits += filter.may_contain(hash(i));
+  EXPECT_LT(hits, keys / 2);
+}
+
+TEST(hashjoin_test, bloom_filtered_join) {
+  int size = 20000;
+  KeyValVec r, s;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, size * 10);
+  for (int i = 0; i < size / 10; i++)
+    r.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  for (int i = 0; i < size; i++)
+    s.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+
+  for (JoinMode mode : {kInnerJoin, kSemiJoin, kAntiJoin}) {
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> out(2);
+    for (bool bloom : {false, true}) {
+      HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator>
+        join(r.begin(), r.end(), s.begin(), s.end(), 4, bloom);
+      std::vector<std::pair<uint64_t, uint64_t>>& pairs = out[bloom];
+      std::mutex lock;
+      auto r_only = [&](int, const std::string&, uint64_t r_val) {
+        std::lock_guard<std::mutex> guard(lock);
+        pairs.push_back(std::make_pair(r_val, 0));
+      };
+      if (mode == kInnerJoin) {
+        join.for_each_match([&](int, const std::string&,
+                                uint64_t r_val, uint64_t s_val) {
+            std::lock_guard<std::mutex> guard(lock);
+            pairs.push_back(std::make_pair(r_val, s_val));
+          }, 4);
+      } else if (mode == kSemiJoin) {
+        join.for_each<kSemiJoin>(r_only, 4);
+      } else {
+        join.for_each<kAntiJoin>(r_only, 4);
+      }
+      std::sort(pairs.begin(), pairs.end());
+    }
+    EXPECT_EQ(out[0], out[1]);
+  }
+}
+
+TEST(hashjoin_test, bloom_filtered_full_outer_throws) {
+  KeyValVec r = {{"a", 1}}, s = {{"a", 2}, {"b", 3}};
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator>
+    join(r.begin(), r.end(), s.begin(), s.end(), 2, true);
+  auto fn = [](int, const std::string&, uint64_t*, uint64_t*) {};
+  EXPECT_THROW(join.for_each<kFullOuterJoin>(fn, 2), std::logic_error);
+  ThreadPool pool(2);
+  EXPECT_THROW(join.for_each<kFullOuterJoin>(fn, pool), std::logic_error);
+  EXPECT_NO_THROW(join.for_each<kLeftOuterJoin>(fn, 2));
+}
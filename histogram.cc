@@ -0,0 +1,235 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <mutex>
+#include "histogram.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HISTOGRAM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace radix_hash {
+
+static void count_scalar(const uint64_t* keys, std::size_t n,
+                         int shift, uint64_t digit_mask,
+                         uint32_t* counters,
+                         uint64_t* ors, uint64_t* ands) {
+  std::size_t partitions = digit_mask + 1, i = 0;
+  uint32_t* row1 = counters + partitions;
+  uint32_t* row2 = row1 + partitions;
+  uint32_t* row3 = row2 + partitions;
+  uint64_t o = *ors, a = *ands;
+
+  for (; i + 4 <= n; i += 4) {
+    counters[(keys[i] >> shift) & digit_mask]++;
+    row1[(keys[i+1] >> shift) & digit_mask]++;
+    row2[(keys[i+2] >> shift) & digit_mask]++;
+    row3[(keys[i+3] >> shift) & digit_mask]++;
+    o |= keys[i] | keys[i+1] | keys[i+2] | keys[i+3];
+    a &= keys[i] & keys[i+1] & keys[i+2] & keys[i+3];
+  }
+  for (; i < n; i++) {
+    counters[(keys[i] >> shift) & digit_mask]++;
+    o |= keys[i];
+    a &= keys[i];
+  }
+  *ors = o;
+  *ands = a;
+}
+
+#ifdef HISTOGRAM_X86
+__attribute__((target("avx2")))
+static void count_avx2(const uint64_t* keys, std::size_t n,
+                       int shift, uint64_t digit_mask,
+                       uint32_t* counters,
+                       uint64_t* ors, uint64_t* ands) {
+  std::size_t partitions = digit_mask + 1, i = 0;
+  uint32_t* row1 = counters + partitions;
+  uint32_t* row2 = row1 + partitions;
+  uint32_t* row3 = row2 + partitions;
+  const __m256i mask = _mm256_set1_epi64x(digit_mask);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  __m256i o = _mm256_set1_epi64x(*ors), a = _mm256_set1_epi64x(*ands);
+  alignas(32) uint64_t d[8];
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i k0 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(keys + i));
+    __m256i k1 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(keys + i + 4));
+    o = _mm256_or_si256(o, _mm256_or_si256(k0, k1));
+    a = _mm256_and_si256(a, _mm256_and_si256(k0, k1));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(d),
+                       _mm256_and_si256(_mm256_srl_epi64(k0, count), mask));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(d + 4),
+                       _mm256_and_si256(_mm256_srl_epi64(k1, count), mask));
+    counters[d[0]]++;
+    row1[d[1]]++;
+    row2[d[2]]++;
+    row3[d[3]]++;
+    counters[d[4]]++;
+    row1[d[5]]++;
+    row2[d[6]]++;
+    row3[d[7]]++;
+  }
+  _mm256_store_si256(reinterpret_cast<__m256i*>(d), o);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(d + 4), a);
+  *ors = d[0] | d[1] | d[2] | d[3];
+  *ands = d[4] & d[5] & d[6] & d[7];
+  count_scalar(keys + i, n - i, shift, digit_mask, counters, ors, ands);
+}
+
+// GCC flags the intrinsics' own undefined vectors.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+// Eight digits per step: gather their counters, add one plus the number of
+// earlier lanes holding the same digit and scatter back. Scatter writes
+// equal addresses in lane order, so the last duplicate lands the total.
+__attribute__((target("avx512f,avx512cd")))
+static void count_avx512(const uint64_t* keys, std::size_t n,
+                         int shift, uint64_t digit_mask,
+                         uint32_t* counters,
+                         uint64_t* ors, uint64_t* ands) {
+  std::size_t i = 0;
+  const __m512i mask = _mm512_set1_epi64(digit_mask);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512i m1 = _mm512_set1_epi64(0x55);
+  const __m512i m2 = _mm512_set1_epi64(0x33);
+  const __m512i m4 = _mm512_set1_epi64(0x0f);
+  __m512i o = _mm512_set1_epi64(*ors), a = _mm512_set1_epi64(*ands);
+
+  for (; i + 8 <= n; i += 8) {
+    __m512i k = _mm512_loadu_si512(keys + i);
+    o = _mm512_or_si512(o, k);
+    a = _mm512_and_si512(a, k);
+    __m512i digits = _mm512_and_si512(_mm512_srl_epi64(k, count), mask);
+    // Conflict bits only cover the 7 lower lanes, a byte wide popcount
+    // is enough.
+    __m512i c = _mm512_conflict_epi64(digits);
+    c = _mm512_sub_epi64(c, _mm512_and_si512(_mm512_srli_epi64(c, 1), m1));
+    c = _mm512_add_epi64(_mm512_and_si512(c, m2),
+                         _mm512_and_si512(_mm512_srli_epi64(c, 2), m2));
+    c = _mm512_and_si512(_mm512_add_epi64(c, _mm512_srli_epi64(c, 4)), m4);
+    __m256i add = _mm512_cvtepi64_epi32(_mm512_add_epi64(c, one));
+    __m256i old = _mm512_i64gather_epi32(digits, counters, 4);
+    _mm512_i64scatter_epi32(counters, digits, _mm256_add_epi32(old, add), 4);
+  }
+  *ors = _mm512_reduce_or_epi64(o);
+  *ands = _mm512_reduce_and_epi64(a);
+  count_scalar(keys + i, n - i, shift, digit_mask, counters, ors, ands);
+}
+#pragma GCC diagnostic pop
+#endif
+
+static HistogramKernel g_kernel = kHistogramScalar;
+static DigitCountKernel g_count = count_scalar;
+static std::once_flag g_kernel_once;
+
+bool histogram_kernel_supported(HistogramKernel kernel) {
+  switch (kernel) {
+  case kHistogramAuto:
+  case kHistogramScalar:
+    return true;
+#ifdef HISTOGRAM_X86
+  case kHistogramAvx2:
+    return __builtin_cpu_supports("avx2");
+  case kHistogramAvx512:
+    return __builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512cd");
+#endif
+  default:
+    return false;
+  }
+}
+
+static void use_kernel(HistogramKernel kernel) {
+  g_kernel = kernel;
+  switch (kernel) {
+#ifdef HISTOGRAM_X86
+  case kHistogramAvx2:
+    g_count = count_avx2;
+    break;
+  case kHistogramAvx512:
+    g_count = count_avx512;
+    break;
+#endif
+  default:
+    g_kernel = kHistogramScalar;
+    g_count = count_scalar;
+  }
+}
+
+// The gather/scatter kernel measured slower than the AVX2 rows even on
+// runs of equal digits, so AVX-512 is only used when asked for.
+static void detect_kernel() {
+  use_kernel(histogram_kernel_supported(kHistogramAvx2) ?
+             kHistogramAvx2 : kHistogramScalar);
+}
+
+HistogramKernel histogram_kernel() {
+  std::call_once(g_kernel_once, detect_kernel);
+  return g_kernel;
+}
+
+bool set_histogram_kernel(HistogramKernel kernel) {
+  std::call_once(g_kernel_once, detect_kernel);
+  if (!histogram_kernel_supported(kernel))
+    return false;
+  if (kernel == kHistogramAuto)
+    detect_kernel();
+  else
+    use_kernel(kernel);
+  return true;
+}
+
+const char* histogram_kernel_name(HistogramKernel kernel) {
+  switch (kernel) {
+  case kHistogramAuto:
+    return "auto";
+  case kHistogramScalar:
+    return "scalar";
+  case kHistogramAvx2:
+    return "avx2";
+  case kHistogramAvx512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+DigitCountKernel digit_count_kernel() {
+  std::call_once(g_kernel_once, detect_kernel);
+  return g_count;
+}
+
+void count_key_digits(const uint64_t* keys, std::size_t n, int shift,
+                      uint64_t digit_mask, std::size_t* counters,
+                      uint64_t* ors, uint64_t* ands) {
+  std::size_t partitions = digit_mask + 1;
+  uint32_t rows[kSubHistograms << kMaxSubHistogramBits];
+
+  for (std::size_t i = 0; i < kSubHistograms * partitions; i++)
+    rows[i] = 0;
+  digit_count_kernel()(keys, n, shift, digit_mask, rows, ors, ands);
+  for (int j = 0; j < kSubHistograms; j++) {
+    for (std::size_t i = 0; i < partitions; i++)
+      counters[i] += rows[j * partitions + i];
+  }
+}
+
+} // namespace radix_hash
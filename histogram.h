@@ -0,0 +1,172 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "radix_key.h"
+
+namespace radix_hash {
+
+// Digit counting kernels for contiguous unsigned 64 bit keys, picked once
+// per process from what the CPU supports unless set_histogram_kernel()
+// says otherwise.
+enum HistogramKernel {
+  // Best supported kernel.
+  kHistogramAuto = 0,
+  // Portable C++, kSubHistograms interleaved counter rows.
+  kHistogramScalar,
+  // AVX2 digit extraction into the counter rows.
+  kHistogramAvx2,
+  // AVX-512 gather/scatter increments, AVX-512CD resolving duplicates.
+  kHistogramAvx512,
+};
+
+// Adds the digits (keys[i] >> shift) & digit_mask of keys[0, n) to
+// counters, kSubHistograms rows of digit_mask + 1 uint32_t each, and folds
+// the keys into *ors and *ands.
+typedef void (*DigitCountKernel)(const uint64_t* keys, std::size_t n,
+                                 int shift, uint64_t digit_mask,
+                                 uint32_t* counters,
+                                 uint64_t* ors, uint64_t* ands);
+
+// Consecutive keys go to different rows, so a run of equal digits does not
+// serialize on one counter's store-to-load forwarding.
+static const int kSubHistograms = 4;
+// Ranges with fewer keys per counter count straight into the caller's
+// counters; clearing and merging the rows would cost more than they save.
+static const std::size_t kMinKeysPerCounter = 32;
+// Larger digits count straight into the caller's counters, the rows would
+// no longer fit in L1.
+static const int kMaxSubHistogramBits = 11;
+
+bool histogram_kernel_supported(HistogramKernel kernel);
+// The kernel in use, never kHistogramAuto.
+HistogramKernel histogram_kernel();
+// Forces a kernel, for tests and benchmarks; must not race with running
+// sorts. Returns false and changes nothing if the CPU lacks it.
+bool set_histogram_kernel(HistogramKernel kernel);
+const char* histogram_kernel_name(HistogramKernel kernel);
+DigitCountKernel digit_count_kernel();
+// Counts keys[0, n) into counters through the kernel in use, n must fit
+// the uint32_t rows and digit_mask kMaxSubHistogramBits.
+void count_key_digits(const uint64_t* keys, std::size_t n, int shift,
+                      uint64_t digit_mask, std::size_t* counters,
+                      uint64_t* ors, uint64_t* ands);
+
+template<typename Iterator>
+static inline void count_digits_scalar(Iterator first,
+                                       Iterator last,
+                                       int shift,
+                                       uint64_t digit_mask,
+                                       std::size_t* counters,
+                                       uint64_t* ors,
+                                       uint64_t* ands) {
+  uint64_t h, o = *ors, a = *ands;
+  for (; first != last; ++first) {
+    h = radix_bits(item_key(*first));
+    counters[(h >> shift) & digit_mask]++;
+    o |= h;
+    a &= h;
+  }
+  *ors = o;
+  *ands = a;
+}
+
+// Whether Iterator walks a contiguous array of unsigned 64 bit keys, whose
+// radix bits are the keys themselves and can go to the kernels in place.
+template<typename Iterator>
+struct ContiguousKeyBits {
+  typedef typename std::remove_cv<
+    typename std::iterator_traits<Iterator>::value_type>::type Item;
+  static const bool value =
+    std::is_unsigned<Item>::value && sizeof(Item) == sizeof(uint64_t) &&
+    (std::is_pointer<Iterator>::value ||
+     std::is_same<Iterator, typename std::vector<Item>::iterator>::value ||
+     std::is_same<Iterator,
+                  typename std::vector<Item>::const_iterator>::value);
+};
+
+template<typename Iterator>
+static inline void count_digits(Iterator first,
+                                Iterator last,
+                                int shift,
+                                uint64_t digit_mask,
+                                std::size_t* counters,
+                                uint64_t* ors,
+                                uint64_t* ands,
+                                std::true_type) {
+  std::size_t n = last - first, partitions = digit_mask + 1;
+  if (digit_mask >> kMaxSubHistogramBits ||
+      n < kMinKeysPerCounter * partitions ||
+      n > std::numeric_limits<uint32_t>::max()) {
+    count_digits_scalar(first, last, shift, digit_mask, counters, ors, ands);
+    return;
+  }
+  count_key_digits(reinterpret_cast<const uint64_t*>(&*first), n, shift,
+                   digit_mask, counters, ors, ands);
+}
+
+// Strided items, say (key, value) pairs, count directly: in the sorts the
+// loop is bound by loading the items, and gathering their keys for the
+// kernels or spreading them over rows measured slower.
+template<typename Iterator>
+static inline void count_digits(Iterator first,
+                                Iterator last,
+                                int shift,
+                                uint64_t digit_mask,
+                                std::size_t* counters,
+                                uint64_t* ors,
+                                uint64_t* ands,
+                                std::false_type) {
+  count_digits_scalar(first, last, shift, digit_mask, counters, ors, ands);
+}
+
+// Adds the digits (radix_bits(item_key(item)) >> shift) & digit_mask of
+// [first, last) to counters and folds the encoded keys into *ors and
+// *ands, so that (*ors ^ *ands) holds the bits that vary.
+template<typename Iterator>
+static inline void count_digits(Iterator first,
+                                Iterator last,
+                                int shift,
+                                uint64_t digit_mask,
+                                std::size_t* counters,
+                                uint64_t* ors,
+                                uint64_t* ands) {
+  count_digits(first, last, shift, digit_mask, counters, ors, ands,
+               std::integral_constant<bool,
+               ContiguousKeyBits<Iterator>::value>());
+}
+
+template<typename Iterator>
+static inline void count_digits(Iterator first,
+                                Iterator last,
+                                int shift,
+                                uint64_t digit_mask,
+                                std::size_t* counters) {
+  uint64_t ors = 0, ands = ~0ULL;
+  count_digits(first, last, shift, digit_mask, counters, &ors, &ands);
+}
+
+} // namespace radix_hash
+
+#endif
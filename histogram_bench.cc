@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The histogram phase of one MSD level alone: counting the digits of keys
+// that fit in L2, per kernel, against the plain counting loop.
+
+#include <vector>
+#include <utility>
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "histogram.h"
+#include "papi_setup.h"
+
+// state.range(1) == 1 gives runs of equal digits, the case the counter
+// rows are meant for.
+static std::vector<uint64_t> create_keys(benchmark::State& state) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> distribution;
+  std::vector<uint64_t> keys(state.range(0));
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    keys[i] = state.range(1) ? (i / 64) * 0x9E3779B97F4A7C15ULL :
+      distribution(generator);
+  }
+  return keys;
+}
+
+static void BM_histogram_plain(benchmark::State& state) {
+  std::vector<uint64_t> keys = create_keys(state);
+  int bits = state.range(2);
+  std::vector<std::size_t> counters(1 << bits);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    uint64_t ors = 0, ands = ~0ULL;
+    START_COUNTERS;
+    radix_hash::count_digits_scalar(keys.begin(), keys.end(), 64 - bits,
+                                    (1ULL << bits) - 1, counters.data(),
+                                    &ors, &ands);
+    ACCUMULATE_COUNTERS;
+    benchmark::DoNotOptimize(counters.data());
+  }
+  REPORT_COUNTERS(state);
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_histogram_kernel(benchmark::State& state,
+                                radix_hash::HistogramKernel kernel) {
+  std::vector<uint64_t> keys = create_keys(state);
+  int bits = state.range(2);
+  std::vector<std::size_t> counters(1 << bits);
+
+  if (!radix_hash::set_histogram_kernel(kernel)) {
+    state.SkipWithError("kernel not supported by this CPU");
+    return;
+  }
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    uint64_t ors = 0, ands = ~0ULL;
+    START_COUNTERS;
+    radix_hash::count_key_digits(keys.data(), keys.size(), 64 - bits,
+                                 (1ULL << bits) - 1, counters.data(),
+                                 &ors, &ands);
+    ACCUMULATE_COUNTERS;
+    benchmark::DoNotOptimize(counters.data());
+  }
+  REPORT_COUNTERS(state);
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.SetComplexityN(state.range(0));
+  radix_hash::set_histogram_kernel(radix_hash::kHistogramAuto);
+}
+
+static void HistogramArguments(benchmark::internal::Benchmark* b) {
+  for (int size : {1 << 13, 1 << 16}) {
+    for (int runs : {0, 1}) {
+      for (int bits : {8, 11})
+        b->Args({size, runs, bits});
+    }
+  }
+}
+
+BENCHMARK(BM_histogram_plain)->Apply(HistogramArguments);
+BENCHMARK_CAPTURE(BM_histogram_kernel, scalar,
+                  radix_hash::kHistogramScalar)->Apply(HistogramArguments);
+BENCHMARK_CAPTURE(BM_histogram_kernel, avx2,
+                  radix_hash::kHistogramAvx2)->Apply(HistogramArguments);
+BENCHMARK_CAPTURE(BM_histogram_kernel, avx512,
+                  radix_hash::kHistogramAvx512)->Apply(HistogramArguments);
+
+BENCHMARK_MAIN();
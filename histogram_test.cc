@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "histogram.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+using radix_hash::HistogramKernel;
+
+static const HistogramKernel kKernels[] = {
+  radix_hash::kHistogramScalar,
+  radix_hash::kHistogramAvx2,
+  radix_hash::kHistogramAvx512,
+};
+
+// Random keys, with runs of equal digits in the second half.
+static std::vector<uint64_t> create_keys(std::size_t size) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> distribution;
+  std::vector<uint64_t> keys(size);
+  for (std::size_t i = 0; i < size; i++) {
+    keys[i] = i < size / 2 ? distribution(generator) :
+      (i / 37) * 0x9E3779B97F4A7C15ULL;
+  }
+  return keys;
+}
+
+static void expect_counts(const std::vector<uint64_t>& keys,
+                          int shift, uint64_t digit_mask) {
+  std::vector<std::size_t> expected(digit_mask + 1), counters(digit_mask + 1);
+  uint64_t ors = 0, ands = ~0ULL, expected_ors = 0, expected_ands = ~0ULL;
+  for (auto key : keys) {
+    expected[(key >> shift) & digit_mask]++;
+    expected_ors |= key;
+    expected_ands &= key;
+  }
+  radix_hash::count_digits(keys.begin(), keys.end(), shift, digit_mask,
+                           counters.data(), &ors, &ands);
+  EXPECT_EQ(expected, counters);
+  EXPECT_EQ(expected_ors, ors);
+  EXPECT_EQ(expected_ands, ands);
+}
+
+TEST(histogram_test, kernels_match_scalar_counts) {
+  // Sizes below, at and past the row threshold, none a multiple of 8.
+  std::vector<uint64_t> keys = create_keys(100003);
+  for (auto kernel : kKernels) {
+    if (!radix_hash::set_histogram_kernel(kernel))
+      continue;
+    SCOPED_TRACE(radix_hash::histogram_kernel_name(kernel));
+    EXPECT_EQ(kernel, radix_hash::histogram_kernel());
+    for (int bits : {1, 4, 8, 11, 12}) {
+      expect_counts(keys, 64 - bits, (1ULL << bits) - 1);
+      expect_counts(keys, 7, (1ULL << bits) - 1);
+      expect_counts(std::vector<uint64_t>(keys.begin(), keys.begin() + 1013),
+                    64 - bits, (1ULL << bits) - 1);
+    }
+  }
+  EXPECT_TRUE(radix_hash::set_histogram_kernel(radix_hash::kHistogramAuto));
+  EXPECT_NE(radix_hash::kHistogramAuto, radix_hash::histogram_kernel());
+}
+
+TEST(histogram_test, encoded_items) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int32_t> distribution;
+  std::vector<std::pair<int32_t, int>> items;
+  std::vector<std::size_t> expected(256), counters(256);
+  uint64_t ors = 0, ands = ~0ULL;
+
+  for (int i = 0; i < 50000; i++) {
+    items.push_back(std::make_pair(distribution(generator), i));
+    expected[radix_hash::radix_bits(items.back().first) >> 24]++;
+  }
+  radix_hash::count_digits(items.begin(), items.end(), 24, 0xFF,
+                           counters.data(), &ors, &ands);
+  EXPECT_EQ(expected, counters);
+  // Only the 32 encoded bits can vary.
+  EXPECT_EQ(0u, (ors ^ ands) >> 32);
+}
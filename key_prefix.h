@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef KEY_PREFIX_H
+#define KEY_PREFIX_H 1
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace radix_hash {
+
+// The 8 bytes of key from offset on as a big-endian integer, zero padded.
+// Comparing prefixes agrees with std::string ordering of the suffixes
+// whenever they differ.
+static inline uint64_t
+key_prefix(const std::string& key, std::size_t offset) {
+  uint64_t prefix = 0;
+  std::size_t len = key.size() > offset ? key.size() - offset : 0;
+  len = len < 8 ? len : 8;
+  for (std::size_t i = 0; i < len; i++) {
+    prefix = prefix << 8 | static_cast<unsigned char>(key[offset + i]);
+  }
+  return len ? prefix << (8 * (8 - len)) : 0;
+}
+
+// First 8 bytes of key, see above.
+static inline uint64_t
+key_prefix(const std::string& key) {
+  return key_prefix(key, 0);
+}
+
+// Key with its cached prefix, for use as the key of (hash, key, value)
+// tuples. Tie-breaks on equal hashes compare the prefix first and only
+// dereference the key body when the prefixes match.
+template<typename Key>
+struct PrefixedKey {
+  PrefixedKey() : prefix(0) {}
+  PrefixedKey(const Key& k) : prefix(key_prefix(k)), key(k) {}
+  PrefixedKey(Key&& k) : prefix(key_prefix(k)), key(std::move(k)) {}
+  PrefixedKey& operator=(const Key& k) {
+    prefix = key_prefix(k);
+    key = k;
+    return *this;
+  }
+
+  bool operator==(const PrefixedKey& other) const {
+    return prefix == other.prefix && key == other.key;
+  }
+  bool operator!=(const PrefixedKey& other) const {
+    return !(*this == other);
+  }
+  bool operator<(const PrefixedKey& other) const {
+    if (prefix != other.prefix)
+      return prefix < other.prefix;
+    return key < other.key;
+  }
+
+  uint64_t prefix;
+  Key key;
+};
+
+// The user visible key of a sorted tuple, with or without a prefix.
+template<typename Key>
+static inline Key& plain_key(Key& key) {
+  return key;
+}
+
+template<typename Key>
+static inline Key& plain_key(PrefixedKey<Key>& key) {
+  return key.key;
+}
+
+} // namespace radix_hash
+
+namespace std {
+template<typename Key>
+struct hash<radix_hash::PrefixedKey<Key>> {
+  std::size_t operator()(const radix_hash::PrefixedKey<Key>& k) const {
+    return std::hash<Key>{}(k.key);
+  }
+};
+} // namespace std
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "key_prefix.h"
+#include "hashjoin.h"
+#include "gtest/gtest.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <map>
+#include <algorithm>
+
+using radix_hash::PrefixedKey;
+
+// Maps every key to one hash so all tie-breaks go through the keys.
+struct constant_hash
+{
+  std::size_t operator()(const std::string&) const {
+    return 42;
+  }
+};
+
+TEST(key_prefix_test, order_matches_string) {
+  std::vector<std::string> keys = {"", "a", "ab", std::string("ab\0", 3),
+                                   "abcdefgh", "abcdefghi", "abcdefgz",
+                                   "b", "\xff", "\x7f"};
+  for (auto&& a : keys) {
+    for (auto&& b : keys) {
+      EXPECT_EQ(a < b, PrefixedKey<std::string>(a) < PrefixedKey<std::string>(b));
+      EXPECT_EQ(a == b, PrefixedKey<std::string>(a) == PrefixedKey<std::string>(b));
+    }
+  }
+  EXPECT_EQ(0x6162000000000000ULL, radix_hash::key_prefix("ab"));
+}
+
+TEST(key_prefix_test, insertion_tie_break) {
+  // Buckets below sqrt(partitions) items are insertion sorted, which
+  // orders equal hashes by key.
+  int size = 7;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, 1000);
+  for (int round = 0; round < 50; round++) {
+    std::vector<std::pair<std::string, uint64_t>> src;
+    std::vector<std::tuple<std::size_t, PrefixedKey<std::string>, uint64_t>> dst(size);
+    std::vector<std::string> std_sorted;
+    for (int i = 0; i < size; i++) {
+      src.push_back(std::make_pair("key_" + std::to_string(distribution(generator)), i));
+      std_sorted.push_back(src.back().first);
+    }
+    std::sort(std_sorted.begin(), std_sorted.end());
+
+    radix_hash::radix_non_inplace_par<PrefixedKey<std::string>,uint64_t,constant_hash>
+      (src.begin(), src.end(), dst.begin(), 1, 6);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(std_sorted[i], std::get<1>(dst[i]).key);
+      EXPECT_EQ(radix_hash::key_prefix(std_sorted[i]), std::get<1>(dst[i]).prefix);
+    }
+  }
+}
+
+TEST(key_prefix_test, hash_merge_join) {
+  int size = 20000;
+  KeyValVec r, s;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, size);
+  for (int i = 0; i < size; i++) {
+    r.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+    s.push_back(std::make_pair(std::to_string(i), 2*i));
+  }
+
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator>
+    plain(r.begin(), r.end(), s.begin(), s.end(), 2);
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator, true>
+    prefixed(r.begin(), r.end(), s.begin(), s.end(), 2);
+  std::vector<std::tuple<std::string, uint64_t, uint64_t>> plain_out, prefixed_out;
+  for (auto t : plain)
+    plain_out.push_back(std::make_tuple(*std::get<0>(t), *std::get<1>(t), *std::get<2>(t)));
+  for (auto t : prefixed)
+    prefixed_out.push_back(std::make_tuple(*std::get<0>(t), *std::get<1>(t), *std::get<2>(t)));
+
+  ASSERT_FALSE(plain_out.empty());
+  EXPECT_EQ(plain_out, prefixed_out);
+  for (auto&& t : prefixed_out) {
+    EXPECT_EQ(std::to_string(std::get<2>(t) / 2), std::get<0>(t));
+  }
+}
+
+TEST(key_prefix_test, for_each_match_many_to_many) {
+  int size = 20000;
+  KeyValVec r, s;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, size / 8);
+  for (int i = 0; i < size; i++) {
+    r.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+    s.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  }
+  std::map<std::string, std::size_t> r_count;
+  std::size_t expected = 0;
+  for (auto&& t : r)
+    r_count[t.first]++;
+  for (auto&& t : s)
+    expected += r_count[t.first];
+
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator, true>
+    join(r.begin(), r.end(), s.begin(), s.end(), 2);
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> out(4);
+  join.for_each_match([&](int thread_id, const std::string& key,
+                          uint64_t r_val, uint64_t s_val) {
+      EXPECT_EQ(r[r_val].first, key);
+      EXPECT_EQ(s[s_val].first, key);
+      out[thread_id].push_back(std::make_pair(r_val, s_val));
+    }, 4);
+  std::vector<std::pair<uint64_t, uint64_t>> pairs;
+  for (auto&& v : out)
+    pairs.insert(pairs.end(), v.begin(), v.end());
+  std::sort(pairs.begin(), pairs.end());
+  EXPECT_EQ(expected, pairs.size());
+  EXPECT_TRUE(std::unique(pairs.begin(), pairs.end()) == pairs.end());
+
+  // On unique keys the per partition iterators together walk the same
+  // matches as the whole join iterator.
+  KeyValVec u;
+  for (int i = 0; i < size; i++)
+    u.push_back(std::make_pair(std::to_string(i), i));
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator>
+    unique(u.begin(), u.end(), u.begin() + size / 2, u.end(), 2);
+  std::size_t whole = 0, split = 0;
+  for (auto it = unique.begin(); it != unique.end(); ++it)
+    whole++;
+  for (int p = 0; p < unique.partitions(); p++) {
+    for (auto it = unique.begin(p); it != unique.end(p); ++it)
+      split++;
+  }
+  EXPECT_EQ(static_cast<std::size_t>(size / 2), whole);
+  EXPECT_EQ(whole, split);
+}
@@ -29,6 +29,7 @@
 #include <atomic>
 #include <thread>
 #include <unordered_map>
+#include "scatter_buffer.h"
 #include "thread_barrier.h"
 
 namespace radix_hash {
@@ -53,24 +54,25 @@ template<
   typedef typename std::tuple_element<1,ItemType>::type Value;
   std::size_t h;
   std::size_t partition_sum;
+  LocalCounters counters(partitions);
 
   for (auto iter = begin; iter != end; ++iter) {
     h = Hash{}(std::get<0>(*iter));
-    (*shared_counters)[thread_id*partitions + (h>>shift)]++;
+    counters[h>>shift]++;
   }
+  counters.publish(&(*shared_counters)[thread_id*partitions]);
 
-  if (barrier->wait()) {
-    for (int i = 0; i < partitions; i++) {
-      partition_sum = 0;
-      for (int j = 0; j < thread_num; j++) {
-        partition_sum += (*shared_counters)[j*partitions + i];
-      }
-      (*dst)[i].reserve(partition_sum);
+  // Every thread sizes its own block of the partitions.
+  barrier->wait();
+  for (int i = partitions * thread_id / thread_num;
+       i < partitions * (thread_id + 1) / thread_num; i++) {
+    partition_sum = 0;
+    for (int j = 0; j < thread_num; j++) {
+      partition_sum += (*shared_counters)[j*partitions + i];
     }
-    barrier->wait();
-  } else {
-    barrier->wait();
+    (*dst)[i].reserve(partition_sum);
   }
+  barrier->wait();
 
   for (auto iter = begin; iter != end; ++iter) {
     h = Hash{}(std::get<0>(*iter));
@@ -142,26 +144,26 @@ template<
                              int shift) {
   std::size_t h;
   std::size_t partition_sum;
+  LocalCounters counters(partitions);
 
   // TODO maybe we can make no sort version in worker as well.
   for (auto iter = begin; iter != end; ++iter) {
     h = Hash{}(std::get<0>(*iter));
-    (*shared_counters)[thread_id*partitions + (h>>shift)]++;
+    counters[h>>shift]++;
   }
+  counters.publish(&(*shared_counters)[thread_id*partitions]);
 
-  // in barrier
-  if (barrier->wait()) {
-    for (int i = 0; i < partitions; i++) {
-      partition_sum = 0;
-      for (int j = 0; j < thread_num; j++) {
-        partition_sum += (*shared_counters)[j*partitions + i];
-      }
-      (*tables)[i].reserve(partition_sum);
+  // Every thread sizes its own block of the partitions.
+  barrier->wait();
+  for (int i = partitions * thread_id / thread_num;
+       i < partitions * (thread_id + 1) / thread_num; i++) {
+    partition_sum = 0;
+    for (int j = 0; j < thread_num; j++) {
+      partition_sum += (*shared_counters)[j*partitions + i];
     }
-    barrier->wait();
-  } else {
-    barrier->wait();
+    (*tables)[i].reserve(partition_sum);
   }
+  barrier->wait();
 
   for (auto iter = begin; iter != end; ++iter) {
     h = Hash{}(std::get<0>(*iter));
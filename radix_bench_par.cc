@@ -22,10 +22,14 @@
 #include <sys/resource.h>
 #include <stdio.h>
 #include <random>
+#include <cmath>
+#include <type_traits>
+#include <chrono>
 
 #include "tbb/parallel_sort.h"
 #include "radix_sort.h"
 #include "radix_hash.h"
+#include "thread_pool.h"
 #include "strgen.h"
 #include "pdqsort/pdqsort.h"
 #include "papi_setup.h"
@@ -136,6 +140,218 @@ static void BM_radix_non_inplace_par_int(benchmark::State& state) {
   state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
 }
 
+static void BM_radix_lsd_par_int(benchmark::State& state, int digit_bits) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work(size);
+  ThreadPool pool(cores);
+  struct rusage u_before, u_after;
+  getrusage(RUSAGE_SELF, &u_before);
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_pair(r, i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_lsd<std::size_t, uint64_t>
+     (input.begin(), input.end(), work.begin(), pool, digit_bits);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+  state.SetComplexityN(state.range(0));
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+}
+
+static void BM_radix_lsd_par_int_8(benchmark::State& state) {
+  BM_radix_lsd_par_int(state, 8);
+}
+
+static void BM_radix_lsd_par_int_11(benchmark::State& state) {
+  BM_radix_lsd_par_int(state, 11);
+}
+
+static void BM_radix_stable_par_int(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work(size);
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_pair(r, i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_stable<std::size_t, uint64_t>
+     (input.begin(), input.end(), work.begin(), cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_radix_non_inplace_par_key_only(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::size_t> input;
+  std::vector<std::size_t> work(size);
+
+  for (int i = 0; i < size; i++) {
+    input.push_back(distribution(generator));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_non_inplace<std::size_t, void>
+     (input.begin(), input.end(), work.begin(), cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_radix_argsort_par(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::size_t> input;
+  std::vector<uint32_t> perm(size);
+
+  for (int i = 0; i < size; i++) {
+    input.push_back(distribution(generator));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_argsort<std::size_t, uint32_t>
+     (input.begin(), input.end(), perm.begin(), cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+// Signed keys span both signs, floating point keys are normal around 0.
+template<typename Key>
+static std::vector<std::pair<Key, uint64_t>> create_typed_keys(int size) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int64_t> int_distribution;
+  std::normal_distribution<double> real_distribution(0, 1e9);
+  std::vector<std::pair<Key, uint64_t>> input;
+
+  for (int i = 0; i < size; i++) {
+    Key r = std::is_floating_point<Key>::value ?
+      static_cast<Key>(real_distribution(generator)) :
+      static_cast<Key>(int_distribution(generator));
+    input.push_back(std::make_pair(r, i));
+  }
+  return input;
+}
+
+template<typename Key>
+static void BM_tbb_sort_typed(benchmark::State& state) {
+  int size = state.range(0);
+  std::vector<std::pair<Key, uint64_t>> input = create_typed_keys<Key>(size);
+  std::vector<std::pair<Key, uint64_t>> work;
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    work = input;
+    state.ResumeTiming();
+    START_COUNTERS;
+    tbb::parallel_sort(work.begin(), work.end(),
+                       [](const std::pair<Key, uint64_t>& a,
+                          const std::pair<Key, uint64_t>& b) {
+                         return a.first < b.first;
+                       });
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+template<typename Key>
+static void BM_radix_inplace_par_typed(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::vector<std::pair<Key, uint64_t>> input = create_typed_keys<Key>(size);
+  std::vector<std::pair<Key, uint64_t>> work;
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    work = input;
+    state.ResumeTiming();
+    START_COUNTERS;
+    ::radix_int_inplace<Key, uint64_t>(work.begin(), size, cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+template<typename Key>
+static void BM_radix_non_inplace_par_typed(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::vector<std::pair<Key, uint64_t>> input = create_typed_keys<Key>(size);
+  std::vector<std::pair<Key, uint64_t>> work(size);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_non_inplace<Key, uint64_t>
+     (input.begin(), input.end(), work.begin(), cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_tbb_sort_int64(benchmark::State& state) {
+  BM_tbb_sort_typed<int64_t>(state);
+}
+
+static void BM_radix_inplace_par_int64(benchmark::State& state) {
+  BM_radix_inplace_par_typed<int64_t>(state);
+}
+
+static void BM_radix_non_inplace_par_int64(benchmark::State& state) {
+  BM_radix_non_inplace_par_typed<int64_t>(state);
+}
+
+static void BM_tbb_sort_double(benchmark::State& state) {
+  BM_tbb_sort_typed<double>(state);
+}
+
+static void BM_radix_inplace_par_double(benchmark::State& state) {
+  BM_radix_inplace_par_typed<double>(state);
+}
+
+static void BM_radix_non_inplace_par_double(benchmark::State& state) {
+  BM_radix_non_inplace_par_typed<double>(state);
+}
+
 static void BM_tbb_sort_str(benchmark::State& state) {
   int size = state.range(0);
   std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(size);
@@ -228,6 +444,334 @@ static void BM_radix_non_inplace_par_str(benchmark::State& state) {
   state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
 }
 
+// Per call cost of small sorts: spawning threads on every call versus
+// reusing the parked workers of a ThreadPool.
+static void BM_call_overhead_int_spawn(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work(size);
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_pair(r, i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_non_inplace<std::size_t, uint64_t>
+     (input.begin(), input.end(), work.begin(), cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_call_overhead_int_pool(benchmark::State& state) {
+  int size = state.range(0);
+  ThreadPool pool(std::thread::hardware_concurrency());
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work(size);
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_pair(r, i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_non_inplace<std::size_t, uint64_t>
+     (input.begin(), input.end(), work.begin(), pool);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_call_overhead_str_spawn(benchmark::State& state) {
+  int size = state.range(0);
+  std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(size);
+  unsigned int cores = std::thread::hardware_concurrency();
+  auto src = ::create_strvec(size);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    radix_hash::radix_non_inplace_par<std::string,uint64_t>(src.begin(),
+                                                            src.end(), dst.begin(),
+                                                            cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_call_overhead_str_pool(benchmark::State& state) {
+  int size = state.range(0);
+  std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(size);
+  ThreadPool pool(std::thread::hardware_concurrency());
+  auto src = ::create_strvec(size);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    radix_hash::radix_non_inplace_par<std::string,uint64_t>(src.begin(),
+                                                            src.end(), dst.begin(),
+                                                            pool);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+// Per phase wall time of one partitioning pass: count, prefix sum over the
+// thread x partition counters, scatter. The scan either runs on the thread
+// that wins the barrier, as it used to, or on every thread through
+// radix_hash::prefix_sum_par. Args are partition bits and threads.
+static void BM_partition_phases(benchmark::State& state, bool parallel_scan) {
+  typedef std::chrono::steady_clock Clock;
+  const int size = 1 << 24;
+  int partition_bits = state.range(0), num_threads = state.range(1);
+  int partitions = 1 << partition_bits, shift = 64 - partition_bits;
+  std::size_t thread_partition = size / num_threads;
+  ThreadPool pool(num_threads);
+  ThreadBarrier barrier(num_threads);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::size_t> input(size), work(size);
+  std::vector<std::size_t> shared_counters(partitions * num_threads);
+  std::vector<std::size_t> block_sums(num_threads);
+  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+  Clock::time_point t0, t1, t2, t3;
+  double count_s = 0, scan_s = 0, scatter_s = 0;
+
+  for (auto&& key : input)
+    key = distribution(generator);
+
+  for (auto _ : state) {
+    std::fill(shared_counters.begin(), shared_counters.end(), 0);
+    pool.run([&](int thread_id) {
+        std::size_t t_begin = thread_id * thread_partition;
+        std::size_t t_end = thread_id == num_threads - 1 ?
+          size : t_begin + thread_partition;
+        std::size_t* counters = &shared_counters[thread_id * partitions];
+        std::size_t tmp_cnt;
+
+        barrier.wait();
+        if (thread_id == 0)
+          t0 = Clock::now();
+        radix_hash::count_digits(input.begin() + t_begin,
+                                 input.begin() + t_end, shift,
+                                 partitions - 1, counters);
+        if (parallel_scan) {
+          barrier.wait();
+          if (thread_id == 0)
+            t1 = Clock::now();
+          radix_hash::prefix_sum_par(shared_counters.data(), partitions,
+                                     thread_id, num_threads, &barrier,
+                                     block_sums.data(), &indexes);
+        } else if (barrier.wait()) {
+          t1 = Clock::now();
+          tmp_cnt = 0;
+          for (int i = 0; i < partitions; i++) {
+            for (int j = 0; j < num_threads; j++) {
+              tmp_cnt += shared_counters[j*partitions + i];
+              shared_counters[j*partitions + i] =
+                tmp_cnt - shared_counters[j*partitions + i];
+            }
+          }
+          barrier.wait();
+        } else {
+          barrier.wait();
+        }
+        if (thread_id == 0)
+          t2 = Clock::now();
+        for (std::size_t i = t_begin; i < t_end; i++)
+          work[counters[input[i] >> shift]++] = input[i];
+        barrier.wait();
+        if (thread_id == 0)
+          t3 = Clock::now();
+      });
+    count_s += std::chrono::duration<double>(t1 - t0).count();
+    scan_s += std::chrono::duration<double>(t2 - t1).count();
+    scatter_s += std::chrono::duration<double>(t3 - t2).count();
+  }
+  state.counters["Count"] = benchmark::Counter(
+      count_s, benchmark::Counter::kAvgIterations);
+  state.counters["Scan"] = benchmark::Counter(
+      scan_s, benchmark::Counter::kAvgIterations);
+  state.counters["Scatter"] = benchmark::Counter(
+      scatter_s, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_partition_phases_serial_scan(benchmark::State& state) {
+  BM_partition_phases(state, false);
+}
+
+static void BM_partition_phases_parallel_scan(benchmark::State& state) {
+  BM_partition_phases(state, true);
+}
+
+// Counting pass of many threads into adjacent rows of one shared matrix,
+// whose row ends share cache lines with the next thread's, against
+// counting into radix_hash::LocalCounters and publishing the row once.
+// The PAPI misses are those of the calling thread, which counts too. Args
+// are partition bits and threads.
+static void BM_count_rows(benchmark::State& state, bool local) {
+  const int size = 1 << 24;
+  int partition_bits = state.range(0), num_threads = state.range(1);
+  int partitions = 1 << partition_bits, shift = 64 - partition_bits;
+  std::size_t thread_partition = size / num_threads;
+  ThreadPool pool(num_threads);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  std::vector<std::size_t> input(size);
+  // Offset by a word so that every row boundary splits a cache line.
+  std::vector<std::size_t> shared_counters(partitions * num_threads + 1);
+
+  for (auto&& key : input)
+    key = distribution(generator);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    std::fill(shared_counters.begin(), shared_counters.end(), 0);
+    START_COUNTERS;
+    pool.run([&](int thread_id) {
+        std::size_t t_begin = thread_id * thread_partition;
+        std::size_t t_end = thread_id == num_threads - 1 ?
+          size : t_begin + thread_partition;
+        std::size_t* row = &shared_counters[thread_id * partitions + 1];
+        if (local) {
+          radix_hash::LocalCounters counters(partitions);
+          for (std::size_t i = t_begin; i < t_end; i++)
+            counters[input[i] >> shift]++;
+          counters.publish(row);
+        } else {
+          for (std::size_t i = t_begin; i < t_end; i++)
+            row[input[i] >> shift]++;
+        }
+      });
+    ACCUMULATE_COUNTERS;
+    benchmark::DoNotOptimize(shared_counters.data());
+  }
+  REPORT_COUNTERS(state);
+  state.SetItemsProcessed(state.iterations() * size);
+}
+
+static void BM_count_shared_rows(benchmark::State& state) {
+  BM_count_rows(state, false);
+}
+
+static void BM_count_local_counters(benchmark::State& state) {
+  BM_count_rows(state, true);
+}
+
+static void ManyThreadArguments(benchmark::internal::Benchmark* b) {
+  for (int bits : {2, 4, 8}) {
+    for (int threads : {32, 64})
+      b->Args({bits, threads});
+  }
+}
+
+// Zipf distributed ranks in [1, universe], skew is the exponent in
+// hundredths. Small ranks dominate, so most items share the top radix
+// partitions and the recursive phase decides the load balance.
+static std::vector<std::size_t> create_zipf_keys(int size, int skew) {
+  const int universe = 1 << 20;
+  std::vector<double> cdf(universe);
+  std::vector<std::size_t> keys(size);
+  std::default_random_engine generator;
+  std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  double sum = 0;
+
+  for (int i = 0; i < universe; i++) {
+    sum += 1.0 / pow(i + 1, skew / 100.0);
+    cdf[i] = sum;
+  }
+  for (int i = 0; i < size; i++) {
+    double r = distribution(generator) * sum;
+    keys[i] = std::lower_bound(cdf.begin(), cdf.end(), r) - cdf.begin() + 1;
+  }
+  return keys;
+}
+
+static void BM_tbb_sort_zipf(benchmark::State& state) {
+  int size = state.range(0);
+  std::vector<std::size_t> keys = create_zipf_keys(size, state.range(1));
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work;
+
+  for (int i = 0; i < size; i++) {
+    input.push_back(std::make_pair(keys[i], i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    work = input;
+    state.ResumeTiming();
+    START_COUNTERS;
+    tbb::parallel_sort(work.begin(), work.end(), pair_cmp);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_radix_inplace_par_zipf(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::vector<std::size_t> keys = create_zipf_keys(size, state.range(1));
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work;
+  ThreadPool pool(cores);
+
+  for (int i = 0; i < size; i++) {
+    input.push_back(std::make_pair(keys[i], i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    work = input;
+    state.ResumeTiming();
+    START_COUNTERS;
+    ::radix_int_inplace<std::size_t, uint64_t>(work.begin(), size, pool);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
+static void BM_radix_non_inplace_par_zipf(benchmark::State& state) {
+  int size = state.range(0);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::vector<std::size_t> keys = create_zipf_keys(size, state.range(1));
+  std::vector<std::pair<std::size_t, uint64_t>> input;
+  std::vector<std::pair<std::size_t, uint64_t>> work(size);
+  ThreadPool pool(cores);
+
+  for (int i = 0; i < size; i++) {
+    input.push_back(std::make_pair(keys[i], i));
+  }
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    ::radix_int_non_inplace<std::size_t, uint64_t>
+     (input.begin(), input.end(), work.begin(), pool);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
 static void RadixArguments(benchmark::internal::Benchmark* b) {
   uint64_t i = 10*1000;
   uint64_t max = 1000*1000*1000;
@@ -240,12 +784,62 @@ static void RadixArguments(benchmark::internal::Benchmark* b) {
   }
 }
 
+static void ZipfArguments(benchmark::internal::Benchmark* b) {
+  for (int i = 1000*1000; i <= 100*1000*1000; i*=10) {
+    for (int skew = 50; skew <= 150; skew += 25)
+      b->Args({i, skew});
+  }
+}
+
+static void PhaseArguments(benchmark::internal::Benchmark* b) {
+  int cores = std::thread::hardware_concurrency();
+  for (int bits = 8; bits <= 16; bits += 4) {
+    for (int threads = 4; threads <= std::max(cores, 64); threads *= 2)
+      b->Args({bits, threads});
+  }
+}
+
+static void SmallArguments(benchmark::internal::Benchmark* b) {
+  for (int i = 10*1000; i <= 1000*1000; i*=10) {
+    b->Args({i});
+    if (i < 1000*1000)
+      b->Args({i*5});
+  }
+}
+
 BENCHMARK(BM_tbb_sort_int)->Apply(RadixArguments);
 BENCHMARK(BM_radix_inplace_par_int)->Apply(RadixArguments);
 BENCHMARK(BM_radix_non_inplace_par_int)->Apply(RadixArguments);
+BENCHMARK(BM_radix_lsd_par_int_8)->Apply(RadixArguments);
+BENCHMARK(BM_radix_lsd_par_int_11)->Apply(RadixArguments);
+BENCHMARK(BM_radix_stable_par_int)->Apply(RadixArguments);
+BENCHMARK(BM_radix_non_inplace_par_key_only)->Apply(RadixArguments);
+BENCHMARK(BM_radix_argsort_par)->Apply(RadixArguments);
+
+BENCHMARK(BM_tbb_sort_int64)->Apply(RadixArguments);
+BENCHMARK(BM_radix_inplace_par_int64)->Apply(RadixArguments);
+BENCHMARK(BM_radix_non_inplace_par_int64)->Apply(RadixArguments);
+BENCHMARK(BM_tbb_sort_double)->Apply(RadixArguments);
+BENCHMARK(BM_radix_inplace_par_double)->Apply(RadixArguments);
+BENCHMARK(BM_radix_non_inplace_par_double)->Apply(RadixArguments);
 
 BENCHMARK(BM_tbb_sort_str)->Apply(RadixArguments);
 BENCHMARK(BM_radix_inplace_par_str)->Apply(RadixArguments);
 BENCHMARK(BM_radix_non_inplace_par_str)->Apply(RadixArguments);
 
+BENCHMARK(BM_call_overhead_int_spawn)->Apply(SmallArguments)->UseRealTime();
+BENCHMARK(BM_call_overhead_int_pool)->Apply(SmallArguments)->UseRealTime();
+BENCHMARK(BM_call_overhead_str_spawn)->Apply(SmallArguments)->UseRealTime();
+BENCHMARK(BM_call_overhead_str_pool)->Apply(SmallArguments)->UseRealTime();
+
+BENCHMARK(BM_partition_phases_serial_scan)->Apply(PhaseArguments)->UseRealTime();
+BENCHMARK(BM_partition_phases_parallel_scan)->Apply(PhaseArguments)->UseRealTime();
+
+BENCHMARK(BM_count_shared_rows)->Apply(ManyThreadArguments)->UseRealTime();
+BENCHMARK(BM_count_local_counters)->Apply(ManyThreadArguments)->UseRealTime();
+
+BENCHMARK(BM_tbb_sort_zipf)->Apply(ZipfArguments)->UseRealTime();
+BENCHMARK(BM_radix_inplace_par_zipf)->Apply(ZipfArguments)->UseRealTime();
+BENCHMARK(BM_radix_non_inplace_par_zipf)->Apply(ZipfArguments)->UseRealTime();
+
 BENCHMARK_MAIN();
@@ -25,6 +25,7 @@
 
 #include "radix_hash.h"
 #include "radix_sort.h"
+#include "string_sort.h"
 #include "strgen.h"
 #include "pdqsort/pdqsort.h"
 #include "papi_setup.h"
@@ -34,6 +35,11 @@ bool str_tuple_cmp (std::tuple<std::size_t, std::string, uint64_t> a,
   return std::get<0>(a) < std::get<0>(b);
 }
 
+bool str_pair_cmp (const std::pair<std::string, uint64_t>& a,
+                   const std::pair<std::string, uint64_t>& b) {
+  return a.first < b.first;
+}
+
 bool pair_cmp (std::pair<std::size_t, uint64_t> a,
                std::pair<std::size_t, uint64_t> b) {
   return std::get<0>(a) < std::get<0>(b);
@@ -266,6 +272,57 @@ static void BM_radix_non_inplace_seq_str(benchmark::State& state) {
   state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
 }
 
+// Lexicographic order rather than hash order, the baseline of
+// BM_radix_str_sort_seq.
+static void BM_pdqsort_str_lex(benchmark::State& state) {
+  int size = state.range(0);
+  auto src = ::create_strvec(size);
+  auto dst = src;
+  struct rusage u_before, u_after;
+  getrusage(RUSAGE_SELF, &u_before);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::copy(src.begin(), src.end(), dst.begin());
+    state.ResumeTiming();
+    START_COUNTERS;
+    pdqsort(dst.begin(), dst.end(), str_pair_cmp);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+
+  state.SetComplexityN(state.range(0));
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+}
+
+static void BM_radix_str_sort_seq(benchmark::State& state) {
+  int size = state.range(0);
+  auto src = ::create_strvec(size);
+  auto dst = src;
+  struct rusage u_before, u_after;
+  getrusage(RUSAGE_SELF, &u_before);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    radix_str_sort(src.begin(), src.end(), dst.begin(), 1);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+
+  state.SetComplexityN(state.range(0));
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+}
+
 static void RadixArguments(benchmark::internal::Benchmark* b) {
   uint64_t i = 10*1000;
   uint64_t max = 1000*1000*1000;
@@ -285,5 +342,7 @@ BENCHMARK(BM_std_sort_str)->Apply(RadixArguments);
 BENCHMARK(BM_pdqsort_str)->Apply(RadixArguments);
 BENCHMARK(BM_radix_inplace_seq_str)->Apply(RadixArguments);
 BENCHMARK(BM_radix_non_inplace_seq_str)->Apply(RadixArguments);
+BENCHMARK(BM_pdqsort_str_lex)->Apply(RadixArguments);
+BENCHMARK(BM_radix_str_sort_seq)->Apply(RadixArguments);
 
 BENCHMARK_MAIN();
@@ -21,6 +21,7 @@
 #include <iterator>
 #include <utility>
 #include <vector>
+#include <tuple>
 #include <functional>
 #include <sys/mman.h>
 #include <memory>
@@ -28,17 +29,25 @@
 #include <atomic>
 #include <thread>
 #include <cmath>
-#include <mutex>
 #include "thread_barrier.h"
+#include "thread_pool.h"
+#include "scatter_buffer.h"
+#include "work_stealing.h"
+#include "tuning.h"
+#include "radix_key.h"
+#include "histogram.h"
+#include "small_sort.h"
 
 // namespace radix_hash?
 namespace radix_hash {
 
-// returns partition bits
+// returns partition bits, from the tuning profile when one is loaded
 static inline int
 optimal_partition(std::size_t input_num) {
   double min_dist = 1.0;
-  int candidate = 0;
+  int candidate = tuned_partition_bits(input_num);
+  if (candidate > 0)
+    return candidate;
   for (int k = 6; k < 15; k++) {
     double log_k_input = log(input_num)/log(1<<k);
     double top = ceil(log_k_input);
@@ -119,183 +128,280 @@ void bf6_insertion_outer(RandomAccessIterator dst,
   }
 }
 
+// One level of the in place hash sort: insertion sorts a small
+// dst[s_begin, s_end) and returns 0, or permutes it into the buckets of
+// the digit below mask_bits, leaving their ends in ends, and returns the
+// bits left under the digit.
 template <typename Key,
   typename Value,
   typename RandomAccessIterator>
-  void bf6_helper_s(RandomAccessIterator dst,
-                    const std::vector<std::pair<std::size_t, std::size_t>>& super_indexes,
-                    int mask_bits,
-                    int partition_bits) {
+  int bf6_split(RandomAccessIterator dst,
+                std::size_t s_begin,
+                std::size_t s_end,
+                int mask_bits,
+                int partition_bits,
+                std::size_t insertion_limit,
+                std::size_t* counters,
+                std::size_t* ends) {
   std::tuple<std::size_t, Key, Value> tmp_bucket;
-  int partitions, sqrt_partitions, iter, shift, new_mask_bits, idx_c;
-  std::size_t h, mask, s_begin, s_end, idx_i, idx_j;
-
+  int partitions, iter, shift, idx_c;
+  std::size_t h, mask, idx_i, idx_j;
+
+  if (s_end - s_begin < 2)
+    return 0;
+  // Partition too small, use insertion sort instead. The sorting network
+  // orders the hashes; insertion sort then only settles equal hashes by
+  // key.
+  if (s_end - s_begin < insertion_limit) {
+    small_sort(dst, s_begin, s_end);
+    bf6_insertion_outer<RandomAccessIterator>(dst, s_begin, s_end);
+    return 0;
+  }
   partitions = 1 << partition_bits;
-  sqrt_partitions = 1 << (partition_bits / 2);
-  mask = (1ULL << mask_bits) - 1ULL;
+  mask = mask_bits >= 64 ? ~0ULL : (1ULL << mask_bits) - 1ULL;
   shift = mask_bits < partition_bits ? 0 : mask_bits - partition_bits;
 
-  std::vector<std::size_t>counters(partitions);
-  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+  // Setup counters for counting sort.
+  for (int i = 0; i < partitions; i++)
+    counters[i] = 0;
+  count_digits(dst + s_begin, dst + s_end, shift, mask >> shift, counters);
+  // Reuse counters as the bucket heads of the permutation, which end up
+  // at the bucket ends.
+  idx_i = s_begin;
+  for (int i = 0; i < partitions; i++) {
+    ends[i] = idx_i + counters[i];
+    counters[i] = idx_i;
+    idx_i = ends[i];
+  }
 
-  for (int s = 0; s < partitions; s++) {
-    s_begin = super_indexes[s].first;
-    s_end = super_indexes[s].second;
-    if (s_end - s_begin < 2)
-      continue;
-    // Partition too small, use insertion sort instead.
-    if (s_end - s_begin < static_cast<std::size_t>(sqrt_partitions)) {
-      bf6_insertion_outer<RandomAccessIterator>(dst, s_begin, s_end);
+  iter = 0;
+  while (iter < partitions) {
+    idx_i = counters[iter];
+    if (idx_i >= ends[iter]) {
+      iter++;
       continue;
     }
-    // Setup counters for counting sort.
-    for (int i = 0; i < partitions; i++)
-      counters[i] = 0;
-    indexes[0].first = s_begin;
-    for (std::size_t i = s_begin; i < s_end; i++) {
-      h = std::get<0>(dst[i]);
-      counters[(h & mask) >> shift]++;
-    }
-    for (int i = 0; i < partitions - 1; i++) {
-      indexes[i].second = indexes[i+1].first = indexes[i].first + counters[i];
-    }
-    indexes[partitions-1].second = indexes[partitions-1].first
-      + counters[partitions-1];
-
-    iter = 0;
-    while (iter < partitions) {
-      idx_i = indexes[iter].first;
-      if (idx_i >= indexes[iter].second) {
-        iter++;
-        continue;
-      }
-      h = std::get<0>(dst[idx_i]);
-      idx_c = static_cast<int>((h & mask) >> shift);
-      if (idx_c == iter) {
-        indexes[iter].first++;
-        continue;
-      }
-      tmp_bucket = std::move(dst[idx_i]);
-      do {
-        h = std::get<0>(tmp_bucket);
-        idx_c = static_cast<int>((h & mask) >> shift);
-        idx_j = indexes[idx_c].first++;
-        std::swap(dst[idx_j], tmp_bucket);
-      } while (idx_j > idx_i);
-    }
-
-    new_mask_bits = mask_bits - partition_bits;
-    if (new_mask_bits <= 0) {
+    h = std::get<0>(dst[idx_i]);
+    idx_c = static_cast<int>((h & mask) >> shift);
+    if (idx_c == iter) {
+      counters[iter]++;
       continue;
     }
-
-    // Reset indexes
-    indexes[0].first = s_begin;
-    for (int i = 1; i < partitions; i++) {
-      indexes[i].first = indexes[i-1].second;
-    }
-    bf6_helper_s<Key,Value,RandomAccessIterator>
-      (dst, indexes, new_mask_bits, partition_bits);
+    tmp_bucket = std::move(dst[idx_i]);
+    do {
+      h = std::get<0>(tmp_bucket);
+      idx_c = static_cast<int>((h & mask) >> shift);
+      idx_j = counters[idx_c]++;
+      std::swap(dst[idx_j], tmp_bucket);
+    } while (idx_j > idx_i);
   }
+  return mask_bits - partition_bits;
 }
 
+// Leaf callback of the parallel sorts that does nothing.
+struct IgnoreLeaves {
+  void operator()(int, std::size_t, std::size_t) const {}
+};
+
+// Hash callback of the partition pass that does nothing.
+struct IgnoreHashes {
+  void operator()(std::size_t) const {}
+};
+
+// Recursive phase shared by the parallel entry points. Threads take tasks
+// from queues, which start out holding the top level partitions. Sub-
+// partitions of at least kStealThreshold items become new tasks at any
+// depth, so a single heavy partition no longer pins its whole subtree to
+// the thread that claimed it. Each thread sorts its tasks on the explicit
+// stack of one MsdScratch.
+// leaf(thread_id, begin, end) gets every dst[begin, end) that the last
+// level left sorted, right after sorting it; all items of one hash share
+// a leaf.
 template <typename Key,
   typename Value,
-  typename RandomAccessIterator>
+  typename RandomAccessIterator,
+  typename Leaf = IgnoreLeaves>
   void bf6_helper_p(RandomAccessIterator dst,
-                    const std::vector<std::pair<std::size_t, std::size_t>>& super_indexes,
-                    int mask_bits,
                     int partition_bits,
-                    std::atomic_int* super_counter) {
-  std::tuple<std::size_t, Key, Value> tmp_bucket;
-  std::size_t h, mask;
-  int partitions, sqrt_partitions, s_idx, iter, idx_c;
-  std::size_t idx_i, idx_j, s_begin, s_end;
-  int shift;
-  int new_mask_bits;
-
-  partitions = 1 << partition_bits;
-  sqrt_partitions = 1 << (partition_bits / 2);
-  mask = (1ULL << mask_bits) - 1ULL;
-  shift = mask_bits < partition_bits ? 0 : mask_bits - partition_bits;
-
-  std::vector<std::size_t>counters(partitions);
-  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
-
-  s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
+                    SortTaskQueues* queues,
+                    int thread_id,
+                    Leaf leaf = Leaf()) {
+  std::size_t insertion_limit = insertion_threshold(partition_bits);
+  MsdScratch scratch(queues->mask_bits(), partition_bits);
+  SortTask task;
+  int partitions = 1 << partition_bits;
+
+  while (queues->next(thread_id, &task)) {
+    msd_sort(task.begin, task.end, task.mask_bits, false, &scratch, queues,
+             thread_id,
+             [&](std::size_t s_begin, std::size_t s_end, int mask_bits,
+                 bool*, std::size_t* ends) {
+               int bits;
+               std::size_t b_begin = s_begin;
+               bool small = s_end - s_begin < 2 ||
+                 s_end - s_begin < insertion_limit;
+               bits = bf6_split<Key, Value>(dst, s_begin, s_end, mask_bits,
+                                            partition_bits, insertion_limit,
+                                            scratch.counters(), ends);
+               if (small) {
+                 leaf(thread_id, s_begin, s_end);
+               } else if (bits <= 0) {
+                 // The digit used up the hash, every bucket is done.
+                 for (int i = 0; i < partitions; i++) {
+                   if (ends[i] > b_begin)
+                     leaf(thread_id, b_begin, ends[i]);
+                   b_begin = ends[i];
+                 }
+               }
+               return bits;
+             });
+    queues->finish();
+  }
+}
 
-  while (s_idx < partitions) {
-    s_begin = super_indexes[s_idx].first;
-    s_end = super_indexes[s_idx].second;
-    if (s_end - s_begin < 2) {
-      s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
-      continue;
-    }
-    // Partition too small, use insertion sort instead.
-    if (s_end - s_begin < static_cast<std::size_t>(sqrt_partitions)) {
-      bf6_insertion_outer<RandomAccessIterator>(dst, s_begin, s_end);
-      s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
-      continue;
-    }
-    // Setup counters for counting sort.
-    for (int i = 0; i < partitions; i++)
-      counters[i] = 0;
-    indexes[0].first = s_begin;
-    for (std::size_t i = s_begin; i < s_end; i++) {
-      h = std::get<0>(dst[i]);
-      counters[(h & mask) >> shift]++;
-    }
-    for (int i = 0; i < partitions - 1; i++) {
-      indexes[i].second = indexes[i+1].first = indexes[i].first + counters[i];
-    }
-    indexes[partitions-1].second = indexes[partitions-1].first
-      + counters[partitions-1];
+// Hash argument of the partitioners for input an upstream stage already
+// hashed: (hash, key, value) tuples whose hash is used as is.
+struct Prehashed {};
+
+// Input items of the non-inplace partitioner: tuple-like (key, value)
+// items, std::get<0> hashed by Hash, or with Hash = Prehashed (hash, key,
+// value) tuples that are never hashed again.
+template<typename Hash, typename Item>
+struct HashInput {
+  typedef typename std::tuple_element<0, Item>::type Key;
+  typedef typename std::tuple_element<1, Item>::type Value;
+  static const bool prehashed = false;
+  static std::size_t hash(const Item& item) {
+    return Hash{}(std::get<0>(item));
+  }
+  static const Key& key(const Item& item) {
+    return std::get<0>(item);
+  }
+  static const Value& value(const Item& item) {
+    return std::get<1>(item);
+  }
+};
+
+template<typename Item>
+struct HashInput<Prehashed, Item> {
+  typedef typename std::tuple_element<1, Item>::type Key;
+  typedef typename std::tuple_element<2, Item>::type Value;
+  static const bool prehashed = true;
+  static std::size_t hash(const Item& item) {
+    return std::get<0>(item);
+  }
+  static const Key& key(const Item& item) {
+    return std::get<1>(item);
+  }
+  static const Value& value(const Item& item) {
+    return std::get<2>(item);
+  }
+};
 
-    iter = 0;
+template<typename Input,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void bf6_scatter_streaming(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             const std::size_t* hashes,
+                             std::size_t* counters,
+                             int partitions,
+                             int shift,
+                             std::true_type) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+    HashTuple;
+  std::size_t h, i = 0;
+  StreamingScatter<HashTuple> buffer(&*dst, partitions);
+
+  for (auto iter = begin; iter != end; ++iter, ++i) {
+    h = Input::prehashed ? Input::hash(*iter) : hashes[i];
+    buffer.push(h >> shift, counters[h >> shift]++,
+                HashTuple(h, Input::key(*iter), Input::value(*iter)));
+  }
+  buffer.flush();
+}
 
-    while (iter < partitions) {
-      idx_i = indexes[iter].first;
-      if (idx_i >= indexes[iter].second) {
-        iter++;
-        continue;
-      }
-      h = std::get<0>(dst[idx_i]);
-      idx_c = static_cast<int>((h & mask) >> shift);
-      if (idx_c == iter) {
-        indexes[iter].first++;
-        continue;
-      }
-      tmp_bucket = std::move(dst[idx_i]);
-      do {
-        h = std::get<0>(tmp_bucket);
-        idx_c = static_cast<int>((h & mask) >> shift);
-        idx_j = indexes[idx_c].first++;
-        std::swap(dst[idx_j], tmp_bucket);
-      } while (idx_j > idx_i);
-    }
+// Items that cannot be copied as raw bytes are scattered directly.
+template<typename Input,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void bf6_scatter_streaming(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             const std::size_t* hashes,
+                             std::size_t* counters,
+                             int,
+                             int shift,
+                             std::false_type) {
+  std::size_t h, dst_idx, i = 0;
+  for (auto iter = begin; iter != end; ++iter, ++i) {
+    h = Input::prehashed ? Input::hash(*iter) : hashes[i];
+    dst_idx = counters[h>>shift]++;
+    std::get<0>(dst[dst_idx]) = h;
+    std::get<1>(dst[dst_idx]) = Input::key(*iter);
+    std::get<2>(dst[dst_idx]) = Input::value(*iter);
+  }
+}
 
-    new_mask_bits = mask_bits - partition_bits;
-    if (new_mask_bits <= 0) {
-      s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
-      continue;
-    }
+// Turns the thread_num x partitions counter matrix, a row of digit counts
+// per thread, into the scatter offsets of every thread: an exclusive
+// prefix sum in partition, then thread order. Every thread of barrier
+// calls it once its row is counted. Thread t scans partitions
+// [t * partitions / thread_num, (t + 1) * partitions / thread_num): it
+// first publishes the total of its block in block_sums[t], then starts
+// from the sum of the blocks before it. The bucket bounds go to indexes
+// unless it is null. Returns after a barrier, with every offset in place.
+static inline void prefix_sum_par(std::size_t* counters,
+                                  int partitions,
+                                  int thread_id,
+                                  int thread_num,
+                                  ThreadBarrier* barrier,
+                                  std::size_t* block_sums,
+                                  std::vector<std::pair<std::size_t,std::size_t>>* indexes) {
+  int p_begin, p_end;
+  std::size_t sum, tmp_cnt;
+
+  p_begin = static_cast<int>(
+      static_cast<long>(partitions) * thread_id / thread_num);
+  p_end = static_cast<int>(
+      static_cast<long>(partitions) * (thread_id + 1) / thread_num);
 
-    // Reset indexes
-    indexes[0].first = s_begin;
-    for (int i = 1; i < partitions; i++) {
-      indexes[i].first = indexes[i-1].second;
+  // in barrier
+  barrier->wait();
+  sum = 0;
+  for (int i = p_begin; i < p_end; i++) {
+    for (int j = 0; j < thread_num; j++)
+      sum += counters[j*partitions + i];
+  }
+  block_sums[thread_id] = sum;
+
+  barrier->wait();
+  sum = 0;
+  for (int t = 0; t < thread_id; t++)
+    sum += block_sums[t];
+  for (int i = p_begin; i < p_end; i++) {
+    if (indexes)
+      (*indexes)[i].first = sum;
+    for (int j = 0; j < thread_num; j++) {
+      tmp_cnt = counters[j*partitions + i];
+      counters[j*partitions + i] = sum;
+      sum += tmp_cnt;
     }
-    bf6_helper_s<Key,Value,RandomAccessIterator>
-      (dst, indexes, new_mask_bits, partition_bits);
-    s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
+    if (indexes)
+      (*indexes)[i].second = sum;
   }
+  barrier->wait();
 }
 
+// on_hash(hash) sees the hash of every item of [begin, end) in the
+// counting pass, concurrently with the other workers.
 template<typename Key,
   typename Value,
   typename Hash,
   typename BidirectionalIterator,
-  typename RandomAccessIterator>
+  typename RandomAccessIterator,
+  typename OnHash = IgnoreHashes>
   void radix_hash_bf6_worker(BidirectionalIterator begin,
                              BidirectionalIterator end,
                              RandomAccessIterator dst,
@@ -303,106 +409,204 @@ template<typename Key,
                              int thread_num,
                              ThreadBarrier* barrier,
                              std::vector<std::size_t>* shared_counters,
+                             std::vector<std::size_t>* block_sums,
                              std::vector<std::pair<std::size_t,std::size_t>>* indexes,
                              int partitions,
-                             int shift) {
-  std::size_t h;
-  std::size_t dst_idx, tmp_cnt;
+                             int shift,
+                             ScatterMode mode,
+                             OnHash on_hash = OnHash()) {
+  typedef HashInput<Hash,
+    typename std::iterator_traits<BidirectionalIterator>::value_type> Input;
+  std::size_t h, pos;
+  std::size_t dst_idx;
+  std::size_t* row = &(*shared_counters)[thread_id*partitions];
+  LocalCounters counters(partitions);
+  // Hashes of this thread's input, kept for the scatter pass so every key
+  // is hashed exactly once.
+  std::vector<std::size_t> hashes(Input::prehashed ?
+                                  0 : std::distance(begin, end));
 
   // TODO maybe we can make no sort version in worker as well.
-  for (auto iter = begin; iter != end; ++iter) {
-    h = Hash{}(std::get<0>(*iter));
-    (*shared_counters)[thread_id*partitions + (h>>shift)]++;
+  pos = 0;
+  for (auto iter = begin; iter != end; ++iter, ++pos) {
+    h = Input::hash(*iter);
+    if (!Input::prehashed)
+      hashes[pos] = h;
+    counters[h>>shift]++;
+    on_hash(h);
   }
 
-  // in barrier
-  if (barrier->wait()) {
-    tmp_cnt = 0;
-    for (int i = 0; i < partitions; i++) {
-      for (int j = 0; j < thread_num; j++) {
-        tmp_cnt += (*shared_counters)[j*partitions + i];
-        (*shared_counters)[j*partitions + i] =
-          tmp_cnt - (*shared_counters)[j*partitions + i];
-      }
-    }
-    (*indexes)[0].first = 0;
-    for (int i = 1; i < partitions; i++) {
-      (*indexes)[i-1].second = (*indexes)[i].first = (*shared_counters)[i];
-    }
-    (*indexes)[partitions-1].second = tmp_cnt;
-
-    barrier->wait();
-  } else {
-    barrier->wait();
+  counters.publish(row);
+  prefix_sum_par(shared_counters->data(), partitions, thread_id,
+                 thread_num, barrier, block_sums->data(), indexes);
+  counters.fetch(row);
+
+  if (mode == kScatterStreaming) {
+    bf6_scatter_streaming<Input>(begin, end, dst, hashes.data(),
+                                 counters.data(),
+                                 partitions, shift,
+                                 std::integral_constant<bool,
+                                 ContiguousStorage<
+                                 RandomAccessIterator>::value &&
+                                 std::is_trivially_copyable<Key>::value &&
+                                 std::is_trivially_copyable<Value>::value>());
+    return;
   }
 
-  for (auto iter = begin; iter != end; ++iter) {
-    h = Hash{}(std::get<0>(*iter));
-    dst_idx = (*shared_counters)[thread_id*partitions + (h>>shift)]++;
+  pos = 0;
+  for (auto iter = begin; iter != end; ++iter, ++pos) {
+    h = Input::prehashed ? Input::hash(*iter) : hashes[pos];
+    dst_idx = counters[h>>shift]++;
     std::get<0>(dst[dst_idx]) = h;
-    std::get<1>(dst[dst_idx]) = iter->first;
-    std::get<2>(dst[dst_idx]) = iter->second;
+    std::get<1>(dst[dst_idx]) = Input::key(*iter);
+    std::get<2>(dst[dst_idx]) = Input::value(*iter);
   }
 }
 
+// Body of the radix_non_inplace_par entry points. Thread t scatters the
+// input range chunk(t) returns, so the chunks need not be adjacent.
+template <typename Key,
+  typename Value,
+  typename Hash,
+  typename Chunk,
+  typename RandomAccessIterator,
+  typename Leaf,
+  typename OnHash>
+  void radix_non_inplace_chunks(Chunk chunk,
+                                RandomAccessIterator dst,
+                                ThreadPool* pool,
+                                int num_threads,
+                                int partition_bits,
+                                ScatterMode mode,
+                                Leaf leaf,
+                                OnHash on_hash) {
+  int shift, partitions, new_mask_bits;
+  ThreadBarrier barrier(num_threads);
+
+  partitions = 1 << partition_bits;
+  shift = 64 - partition_bits;
+  new_mask_bits = 64 - partition_bits;
+
+  std::vector<std::size_t> shared_counters(partitions*num_threads);
+  std::vector<std::size_t> block_sums(num_threads);
+  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+  SortTaskQueues queues(num_threads, &indexes, new_mask_bits);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      auto range = chunk(thread_id);
+      radix_hash_bf6_worker<Key,Value,Hash>(range.first, range.second, dst,
+                                            thread_id, num_threads,
+                                            &barrier, &shared_counters,
+                                            &block_sums, &indexes,
+                                            partitions, shift,
+                                            mode, on_hash);
+      // Every scatter must land before any partition gets sorted.
+      barrier.wait();
+      // The queues skip single item partitions, which are leaves as is.
+      for (int p = partitions * thread_id / num_threads;
+           !std::is_same<Leaf, IgnoreLeaves>::value &&
+             p < partitions * (thread_id + 1) / num_threads; p++) {
+        if (indexes[p].second - indexes[p].first == 1)
+          leaf(thread_id, indexes[p].first, indexes[p].second);
+      }
+      bf6_helper_p<Key,Value, RandomAccessIterator>(
+          dst, partition_bits, &queues, thread_id, leaf);
+    });
+}
+
 // Features:
 // * Use all bits to sort
 // * worker do not use atomic (less memory sync)
+// * both phases run on the same threads; pass a ThreadPool to reuse
+//   parked workers across calls instead of spawning new ones.
+// * kScatterStreaming stages the scatter in cache line buffers, which
+//   pays off once dst is much larger than the last level cache.
+// * every key is hashed once. With Hash = Prehashed, begin..end yields
+//   (hash, key, value) tuples whose hash is used as is.
+// * num_threads <= 0 takes the thread count of the tuning profile named by
+//   $FUNNELHASH_TUNING (see radix_tune), or all cores without one.
+// * leaf is handed every finished leaf range of dst, see bf6_helper_p.
+// * on_hash is handed every hash while the input is counted, see
+//   radix_hash_bf6_worker.
 template <typename Key,
   typename Value,
   typename Hash = std::hash<Key>,
   typename BidirectionalIterator,
-  typename RandomAccessIterator>
+  typename RandomAccessIterator,
+  typename Leaf = IgnoreLeaves,
+  typename OnHash = IgnoreHashes>
   void radix_non_inplace_par(BidirectionalIterator begin,
                              BidirectionalIterator end,
                              RandomAccessIterator dst,
+                             ThreadPool* pool,
                              int num_threads,
-                             int partition_bits) {
-  int input_num, shift, partitions, thread_partition, new_mask_bits;
-  std::atomic_int a_counter(0);
-  ThreadBarrier barrier(num_threads);
-
-  partitions = 1 << partition_bits;
-  input_num = std::distance(begin, end);
-  thread_partition = input_num / num_threads;
-
-  shift = 64 - partition_bits;
-
-  std::vector<std::size_t> shared_counters(partitions*num_threads);
-  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
-  std::vector<std::thread> threads(num_threads);
-
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(radix_hash_bf6_worker<Key,Value,Hash,
-                             BidirectionalIterator, RandomAccessIterator>,
-                             begin + i * thread_partition,
-                             begin + (i+1) * thread_partition,
-                             dst, i, num_threads,
-                             &barrier, &shared_counters, &indexes,
-                             partitions, shift);
-  }
+                             int partition_bits,
+                             ScatterMode mode = kScatterDirect,
+                             Leaf leaf = Leaf(),
+                             OnHash on_hash = OnHash()) {
+  int thread_partition = std::distance(begin, end) / num_threads;
+  radix_non_inplace_chunks<Key,Value,Hash>(
+      [&](int thread_id)
+      -> std::pair<BidirectionalIterator, BidirectionalIterator> {
+        return std::make_pair(begin + thread_id * thread_partition,
+                              thread_id == num_threads - 1 ?
+                              end : begin + (thread_id + 1) * thread_partition);
+      },
+      dst, pool, num_threads, partition_bits, mode, leaf, on_hash);
+}
 
-  radix_hash_bf6_worker<Key,Value,Hash>(begin+(num_threads-1)*thread_partition,
-                                        end, dst, num_threads-1, num_threads,
-                                        &barrier, &shared_counters, &indexes,
-                                        partitions, shift);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+// radix_non_inplace_par over the concatenation of runs, without copying
+// them together: each run is scattered by a thread of its own.
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Run,
+  typename RandomAccessIterator>
+  void radix_non_inplace_runs(std::vector<Run>* runs,
+                              RandomAccessIterator dst,
+                              ThreadPool* pool,
+                              int partition_bits,
+                              ScatterMode mode = kScatterDirect) {
+  typedef typename Run::iterator RunIterator;
+  radix_non_inplace_chunks<Key,Value,Hash>(
+      [runs](int thread_id) -> std::pair<RunIterator, RunIterator> {
+        return std::make_pair((*runs)[thread_id].begin(),
+                              (*runs)[thread_id].end());
+      },
+      dst, pool, static_cast<int>(runs->size()), partition_bits, mode,
+      IgnoreLeaves(), IgnoreHashes());
+}
 
-  new_mask_bits = 64 - partition_bits;
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_non_inplace_par(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             int num_threads,
+                             int partition_bits,
+                             ScatterMode mode = kScatterDirect) {
+  radix_non_inplace_par<Key,Value,Hash,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, nullptr,
+    tuned_threads(num_threads, std::distance(begin, end)),
+    partition_bits, mode);
+}
 
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(bf6_helper_p<Key,Value, RandomAccessIterator>,
-                             dst, indexes, new_mask_bits,
-                             partition_bits, &a_counter);
-  }
-  bf6_helper_p<Key,Value, RandomAccessIterator>(
-      dst, indexes, new_mask_bits,
-      partition_bits, &a_counter);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_non_inplace_par(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             ThreadPool& pool,
+                             int partition_bits,
+                             ScatterMode mode = kScatterDirect) {
+  radix_non_inplace_par<Key,Value,Hash,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, &pool, pool.size(), partition_bits, mode);
 }
 
 template <typename Key,
@@ -424,62 +628,95 @@ template <typename Key,
 
 template <typename Key,
   typename Value,
+  typename Hash = std::hash<Key>,
+  typename BidirectionalIterator,
   typename RandomAccessIterator>
-  void radix_inplace_seq(RandomAccessIterator dst,
-                         std::size_t input_num,
-                         int partition_bits) {
-  int shift, new_mask_bits;
-  int iter, idx_c, partitions;
-  std::size_t h, idx_i, idx_j;
-  std::atomic_int a_counter(0);
-  std::tuple<std::size_t, Key, Value> tmp_bucket;
-
-  partitions = 1 << partition_bits;
-  shift = 64 - partition_bits;
+  void radix_non_inplace_par(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             ThreadPool& pool) {
+  std::size_t input_num;
+  int partition_bits;
+  input_num = std::distance(begin, end);
+  partition_bits = optimal_partition(input_num);
+  radix_non_inplace_par<Key,Value,Hash,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, pool, partition_bits);
+}
 
-  std::size_t counters[partitions];
-  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+// Only the partition pass of radix_non_inplace_par: dst ends up grouped
+// by the top partition_bits hash bits, unsorted within a partition, and
+// (*indexes)[p] holds the [begin, end) of partition p.
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_partition_par(BidirectionalIterator begin,
+                           BidirectionalIterator end,
+                           RandomAccessIterator dst,
+                           ThreadPool* pool,
+                           int num_threads,
+                           int partition_bits,
+                           std::vector<std::pair<std::size_t, std::size_t>>* indexes,
+                           ScatterMode mode = kScatterDirect) {
+  int input_num, partitions, thread_partition;
+  ThreadBarrier barrier(num_threads);
 
-  // Setup counters for counting sort.
-  for (int i = 0; i < partitions; i++)
-    counters[i] = 0;
-  indexes[0].first = 0;
-  for (std::size_t i = 0; i < input_num; i++) {
-    h = std::get<0>(dst[i]);
-    counters[h >> shift]++;
-  }
-  for (int i = 0; i < partitions - 1; i++) {
-    indexes[i].second = indexes[i+1].first = indexes[i].first + counters[i];
-  }
-  indexes[partitions-1].second = indexes[partitions-1].first
-  + counters[partitions-1];
+  partitions = 1 << partition_bits;
+  input_num = std::distance(begin, end);
+  thread_partition = input_num / num_threads;
 
-  iter = 0;
-  while (iter < partitions) {
-    idx_i = indexes[iter].first;
-    if (idx_i >= indexes[iter].second) {
-      iter++;
-      continue;
-    }
-    tmp_bucket = std::move(dst[idx_i]);
-    do {
-      h = std::get<0>(tmp_bucket);
-      idx_c = static_cast<int>(h >> shift);
-      idx_j = indexes[idx_c].first++;
-      std::swap(dst[idx_j], tmp_bucket);
-    } while (idx_j > idx_i);
-  }
+  std::vector<std::size_t> shared_counters(partitions*num_threads);
+  std::vector<std::size_t> block_sums(num_threads);
+  indexes->resize(partitions);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      BidirectionalIterator t_begin = begin + thread_id * thread_partition;
+      BidirectionalIterator t_end = thread_id == num_threads - 1 ?
+        end : begin + (thread_id + 1) * thread_partition;
+      radix_hash_bf6_worker<Key,Value,Hash>(t_begin, t_end, dst,
+                                            thread_id, num_threads,
+                                            &barrier, &shared_counters,
+                                            &block_sums, indexes,
+                                            partitions, 64 - partition_bits,
+                                            mode);
+    });
+}
 
-  // Reset indexes
-  indexes[0].first = 0;
-  for (int i = 1; i < partitions; i++) {
-    indexes[i].first = indexes[i-1].second;
-  }
-  new_mask_bits = 64 - partition_bits;
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_partition_par(BidirectionalIterator begin,
+                           BidirectionalIterator end,
+                           RandomAccessIterator dst,
+                           int num_threads,
+                           int partition_bits,
+                           std::vector<std::pair<std::size_t, std::size_t>>* indexes,
+                           ScatterMode mode = kScatterDirect) {
+  radix_partition_par<Key,Value,Hash,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, nullptr,
+    tuned_threads(num_threads, std::distance(begin, end)),
+    partition_bits, indexes, mode);
+}
 
-  bf6_helper_p<Key,Value, RandomAccessIterator>(
-      dst, indexes, new_mask_bits,
-      partition_bits, &a_counter);
+template <typename Key,
+  typename Value,
+  typename RandomAccessIterator>
+  void radix_inplace_seq(RandomAccessIterator dst,
+                         std::size_t input_num,
+                         int partition_bits) {
+  std::size_t insertion_limit = insertion_threshold(partition_bits);
+  MsdScratch scratch(64, partition_bits);
+
+  msd_sort(0, input_num, 64, false, &scratch, nullptr, 0,
+           [&](std::size_t s_begin, std::size_t s_end, int mask_bits,
+               bool*, std::size_t* ends) {
+             return bf6_split<Key, Value>(dst, s_begin, s_end, mask_bits,
+                                          partition_bits, insertion_limit,
+                                          scratch.counters(), ends);
+           });
 }
 
 template <typename Key,
@@ -492,103 +729,193 @@ template <typename Key,
   radix_inplace_seq<Key,Value,RandomAccessIterator>(dst, input_num, partition_bits);
 }
 
-template<typename Key,
-  typename Value,
-  typename RandomAccessIterator>
-  void radix_hash_bf8_worker(RandomAccessIterator dst,
-                             std::size_t begin,
-                             std::size_t end,
-                             int thread_id,
-                             ThreadBarrier* barrier,
-                             std::vector<std::mutex>* locks,
-                             std::vector<std::atomic_size_t>* shared_counters,
-                             std::vector<std::pair<std::size_t, std::size_t>>* sort_indexes,
-                             std::vector<std::pair<std::size_t, std::size_t>>* indexes,
-                             int partitions,
-                             int shift) {
-  std::size_t h;
-  std::size_t local_counters[partitions];
-  std::size_t idx_i, idx_j;
-  int iter, idx_c;
-  std::tuple<std::size_t, Key, Value> tmp_bucket;
+// Shared state of the PARADIS style in-place partitioner. Bucket i owns
+// [indexes[i].first, indexes[i].second); [heads[i], indexes[i].second) is
+// the part that may still hold items of other buckets, from the first
+// repair on.
+struct ParadisState {
+  ParadisState(int partitions, int num_threads)
+    : shared_counters(partitions * num_threads), block_sums(num_threads),
+      indexes(partitions), heads(partitions),
+      stripe_heads(num_threads, std::vector<std::size_t>(partitions)),
+      stripe_tails(num_threads, std::vector<std::size_t>(partitions)),
+      repair_counter(0), last_remaining(0), done(false) {}
+  // Digit counts, a row per thread, until prefix_sum_par() sets indexes.
+  std::vector<std::size_t> shared_counters;
+  std::vector<std::size_t> block_sums;
+  std::vector<std::pair<std::size_t, std::size_t>> indexes;
+  std::vector<std::size_t> heads;
+  // Every thread permutes its own stripe of each bucket.
+  std::vector<std::vector<std::size_t>> stripe_heads;
+  std::vector<std::vector<std::size_t>> stripe_tails;
+  std::atomic_int repair_counter;
+  std::size_t last_remaining;
+  bool done;
+};
+
+// Bucket of item on the digit of its key selected by shift and digit_mask.
+template<typename Item>
+static inline int radix_digit(const Item& item, int shift, int digit_mask) {
+  return static_cast<int>(radix_bits(item_key(item)) >> shift) & digit_mask;
+}
 
-  for (int i = 0; i < partitions; i++)
-    local_counters[i] = 0;
+// Cycle leader permutation restricted to one thread's stripes. Afterwards
+// [old ph[i], ph[i]) holds items of bucket i and [ph[i], pt[i]) holds items
+// that found no free slot in this thread's stripe of their bucket.
+template<typename RandomAccessIterator>
+void paradis_permute(RandomAccessIterator dst,
+                     std::size_t* ph,
+                     const std::size_t* pt,
+                     int partitions,
+                     int shift) {
+  typename std::iterator_traits<RandomAccessIterator>::value_type tmp_bucket;
+  std::size_t head;
+  int idx_c, digit_mask = partitions - 1;
 
-  for (std::size_t i = begin; i < end; ++i) {
-    h = std::get<0>(dst[i]);
-    local_counters[h >> shift]++;
-  }
   for (int i = 0; i < partitions; i++) {
-    (*shared_counters)[i].fetch_add(local_counters[i],
-                                    std::memory_order_relaxed);
+    head = ph[i];
+    while (head < pt[i]) {
+      tmp_bucket = std::move(dst[head]);
+      idx_c = radix_digit(tmp_bucket, shift, digit_mask);
+      while (idx_c != i && ph[idx_c] < pt[idx_c]) {
+        std::swap(tmp_bucket, dst[ph[idx_c]++]);
+        idx_c = radix_digit(tmp_bucket, shift, digit_mask);
+      }
+      if (idx_c == i) {
+        if (head != ph[i])
+          dst[head] = std::move(dst[ph[i]]);
+        dst[ph[i]++] = std::move(tmp_bucket);
+      } else {
+        dst[head] = std::move(tmp_bucket);
+      }
+      head++;
+    }
   }
+}
 
-  // in barrier
-  if (barrier->wait()) {
-    (*indexes)[0].first = 0;
-    (*sort_indexes)[0].first = (*sort_indexes)[0].second = 0;
-    for (int i = 0; i < partitions - 1; i++) {
-      (*indexes)[i].second =
-       (*sort_indexes)[i+1].first =
-       (*sort_indexes)[i+1].second = 
-       (*indexes)[i+1].first = (*indexes)[i].first +
-       (*shared_counters)[i].load(std::memory_order_relaxed);
+// Gathers the misplaced items of bucket `part` at its tail, so that only
+// [heads[part], indexes[part].second) needs another round.
+template<typename RandomAccessIterator>
+void paradis_repair(RandomAccessIterator dst,
+                    ParadisState* state,
+                    int part,
+                    int thread_num,
+                    int shift) {
+  std::size_t head, tail, stripe_end;
+  int digit_mask = static_cast<int>(state->indexes.size()) - 1;
+  bool swapped;
+
+  tail = state->indexes[part].second;
+  for (int t = 0; t < thread_num; t++) {
+    head = state->stripe_heads[t][part];
+    stripe_end = state->stripe_tails[t][part];
+    while (head < stripe_end && head < tail) {
+      if (radix_digit(dst[head++], shift, digit_mask) == part)
+        continue;
+      swapped = false;
+      while (head < tail) {
+        --tail;
+        if (radix_digit(dst[tail], shift, digit_mask) == part) {
+          std::swap(dst[head-1], dst[tail]);
+          swapped = true;
+          break;
+        }
+      }
+      if (!swapped) {
+        // Everything from head-1 on is misplaced.
+        tail = head - 1;
+      }
     }
-    (*indexes)[partitions-1].second = (*indexes)[partitions-1].first
-      + (*shared_counters)[partitions-1].load(std::memory_order_relaxed);
-    barrier->wait();
-  } else {
-    barrier->wait();
   }
+  state->heads[part] = tail;
+}
 
-  // scatter threads in partitions
-  iter = (thread_id*17) % partitions;
-  while (iter < partitions) {
-    (*locks)[iter].lock();
-   retry_no_lock:
-    if ((*sort_indexes)[iter].first >= (*indexes)[iter].second) {
-      (*locks)[iter].unlock();
-      iter++;
-      continue;
+// In-place parallel partitioning by the log2(partitions) bits of the
+// item_key() from shift up, after PARADIS (Cho et al., VLDB 2015).
+// Threads permute disjoint stripes of every bucket without locks, then
+// claim buckets through an atomic counter to repair what the speculative
+// permutation left misplaced. Rounds repeat on the shrinking leftovers;
+// the last small or stalled round is finished by one thread, where the
+// permutation is exact.
+template<typename RandomAccessIterator>
+void radix_paradis_worker(RandomAccessIterator dst,
+                          std::size_t begin,
+                          std::size_t end,
+                          int thread_id,
+                          int thread_num,
+                          ThreadBarrier* barrier,
+                          ParadisState* state,
+                          int partitions,
+                          int shift) {
+  LocalCounters local_counters(partitions);
+  std::vector<std::size_t>& ph = state->stripe_heads[thread_id];
+  std::vector<std::size_t>& pt = state->stripe_tails[thread_id];
+  std::size_t head, len, remaining;
+  bool first_round = true;
+  int part;
+
+  // Only the bucket bounds matter here, the offsets each thread gets from
+  // the prefix sum go unused.
+  count_digits(dst + begin, dst + end, shift, partitions - 1,
+               local_counters.data());
+  local_counters.publish(&state->shared_counters[thread_id * partitions]);
+  prefix_sum_par(state->shared_counters.data(), partitions, thread_id,
+                 thread_num, barrier, state->block_sums.data(),
+                 &state->indexes);
+
+  while (true) {
+    // Every bucket is repaired each round, which sets its head.
+    for (int i = 0; i < partitions; i++) {
+      head = first_round ? state->indexes[i].first : state->heads[i];
+      len = state->indexes[i].second - head;
+      ph[i] = head + len * thread_id / thread_num;
+      pt[i] = head + len * (thread_id + 1) / thread_num;
     }
-    idx_i = (*sort_indexes)[iter].first++;
+    paradis_permute(dst, ph.data(), pt.data(), partitions, shift);
+    barrier->wait();
 
-    h = std::get<0>(dst[idx_i]);
-    idx_c = static_cast<int>(h >> shift);
-    if (idx_c == iter) {
-      idx_j = (*sort_indexes)[iter].second++;
-      if (idx_i != idx_j) {
-        std::swap(dst[idx_i], dst[idx_j]);
-      }
-      goto retry_no_lock;
+    part = state->repair_counter.fetch_add(1, std::memory_order_relaxed);
+    while (part < partitions) {
+      paradis_repair(dst, state, part, thread_num, shift);
+      part = state->repair_counter.fetch_add(1, std::memory_order_relaxed);
     }
 
-    tmp_bucket = std::move(dst[idx_i]);
-    (*locks)[iter].unlock();
-    while (true) {
-      h = std::get<0>(tmp_bucket);
-      idx_c = static_cast<int>(h >> shift);
-      (*locks)[idx_c].lock();
-      if ((*sort_indexes)[idx_c].first > (*sort_indexes)[idx_c].second) {
-        // We have a blank spot to fill tmp_bucket in
-        idx_j = (*sort_indexes)[idx_c].second++;
-        dst[idx_j] = std::move(tmp_bucket);
-        (*locks)[idx_c].unlock();
-        break;
+    if (barrier->wait()) {
+      remaining = 0;
+      for (int i = 0; i < partitions; i++) {
+        remaining += state->indexes[i].second - state->heads[i];
       }
-      idx_j = (*sort_indexes)[idx_c].first;
-      (*sort_indexes)[idx_c].first++;
-      (*sort_indexes)[idx_c].second++;
-      std::swap(tmp_bucket, dst[idx_j]);
-      (*locks)[idx_c].unlock();
+      // A few leftovers per bucket are cheaper to place on one thread than
+      // in another round of three barriers.
+      if (remaining > 0 &&
+          (remaining <= static_cast<std::size_t>(partitions) * thread_num
+           || remaining >= (first_round ?
+                            state->indexes[partitions-1].second :
+                            state->last_remaining))) {
+        for (int i = 0; i < partitions; i++) {
+          ph[i] = state->heads[i];
+          pt[i] = state->indexes[i].second;
+        }
+        paradis_permute(dst, ph.data(), pt.data(), partitions, shift);
+        remaining = 0;
+      }
+      state->repair_counter.store(0, std::memory_order_relaxed);
+      state->last_remaining = remaining;
+      state->done = remaining == 0;
+      barrier->wait();
+    } else {
+      barrier->wait();
     }
+    if (state->done)
+      break;
+    first_round = false;
   }
 }
 
 template <typename RandomAccessIterator>
 void radix_inplace_par(RandomAccessIterator dst,
                        std::size_t input_num,
+                       ThreadPool* pool,
                        int num_threads,
                        int partition_bits) {
   typedef typename std::tuple_element<1,
@@ -597,51 +924,45 @@ void radix_inplace_par(RandomAccessIterator dst,
     typename RandomAccessIterator::value_type>::type Value;
 
   int shift, partitions, thread_partition, new_mask_bits;
-  std::atomic_int a_counter(0);
   ThreadBarrier barrier(num_threads);
 
   partitions = 1 << partition_bits;
   thread_partition = input_num / num_threads;
 
   shift = 64 - partition_bits;
+  new_mask_bits = 64 - partition_bits;
 
-  std::vector<std::atomic_size_t> shared_counters(partitions);
-  std::vector<std::mutex> locks(partitions);
-  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
-  std::vector<std::pair<std::size_t, std::size_t>> sort_indexes(partitions);
-  std::vector<std::thread> threads(num_threads);
-
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(radix_hash_bf8_worker<Key,Value,
-                             RandomAccessIterator>,
-                             dst, i * thread_partition,
-                             (i+1) * thread_partition,
-                             i, &barrier, &locks, &shared_counters,
-                             &sort_indexes, &indexes,
-                             partitions, shift);
-  }
-
-  radix_hash_bf8_worker<Key,Value>(dst, (num_threads-1)*thread_partition,
-                                   input_num, num_threads-1, &barrier, &locks,
-                                   &shared_counters, &sort_indexes, &indexes,
-                                   partitions, shift);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+  ParadisState state(partitions, num_threads);
+  SortTaskQueues queues(num_threads, &state.indexes, new_mask_bits);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : (thread_id + 1) * thread_partition;
+      radix_paradis_worker(dst, thread_id * thread_partition, t_end,
+                           thread_id, num_threads, &barrier, &state,
+                           partitions, shift);
+      bf6_helper_p<Key,Value, RandomAccessIterator>(
+          dst, partition_bits, &queues, thread_id);
+    });
+}
 
-  new_mask_bits = 64 - partition_bits;
+template <typename RandomAccessIterator>
+void radix_inplace_par(RandomAccessIterator dst,
+                       std::size_t input_num,
+                       int num_threads,
+                       int partition_bits) {
+  radix_inplace_par<RandomAccessIterator>(dst, input_num, nullptr,
+                                          tuned_threads(num_threads, input_num),
+                                          partition_bits);
+}
 
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(bf6_helper_p<Key,Value, RandomAccessIterator>,
-                             dst, indexes, new_mask_bits,
-                             partition_bits, &a_counter);
-  }
-  bf6_helper_p<Key,Value, RandomAccessIterator>(
-      dst, indexes, new_mask_bits,
-      partition_bits, &a_counter);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+template <typename RandomAccessIterator>
+void radix_inplace_par(RandomAccessIterator dst,
+                       std::size_t input_num,
+                       ThreadPool& pool,
+                       int partition_bits) {
+  radix_inplace_par<RandomAccessIterator>(dst, input_num, &pool,
+                                          pool.size(), partition_bits);
 }
 
 template <typename RandomAccessIterator>
@@ -652,5 +973,14 @@ void radix_inplace_par(RandomAccessIterator dst,
   partition_bits = optimal_partition(input_num);
   radix_inplace_par<RandomAccessIterator>(dst, input_num, num_threads, partition_bits);
 }
+
+template <typename RandomAccessIterator>
+void radix_inplace_par(RandomAccessIterator dst,
+                       std::size_t input_num,
+                       ThreadPool& pool) {
+  int partition_bits;
+  partition_bits = optimal_partition(input_num);
+  radix_inplace_par<RandomAccessIterator>(dst, input_num, pool, partition_bits);
+}
 }
 #endif
@@ -21,8 +21,10 @@
 #include <assert.h>
 #include <sys/resource.h>
 #include <stdio.h>
+#include <random>
 
 #include "radix_hash.h"
+#include "radix_index.h"
 #include "strgen.h"
 #include "tbb/parallel_sort.h"
 #include "pdqsort/pdqsort.h"
@@ -171,6 +173,59 @@ static void RadixArguments(benchmark::internal::Benchmark* b) {
   }
 }
 
+// Sorts only (hash, row) arrays and gathers the string payload once.
+static void BM_radix_index_par(benchmark::State& state) {
+  int size = state.range(0);
+  std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(size);
+  std::vector<std::size_t> hashes(size);
+  std::vector<uint32_t> rows(size);
+  auto src = ::create_strvec(size);
+  unsigned int cores = std::thread::hardware_concurrency();
+  ThreadPool pool(cores);
+  struct rusage u_before, u_after;
+  getrusage(RUSAGE_SELF, &u_before);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    radix_hash::radix_index_par<std::string,uint64_t>(src.begin(), src.end(),
+                                                      hashes.data(),
+                                                      rows.data(), pool);
+    radix_hash::gather_rows(src.begin(), hashes.data(), rows.data(), size,
+                            dst.begin(), &pool, cores);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+
+  state.SetComplexityN(state.range(0));
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+}
+
+// Permutation only, the payload is never touched after hashing.
+static void BM_radix_index_par_no_gather(benchmark::State& state) {
+  int size = state.range(0);
+  std::vector<std::size_t> hashes(size);
+  std::vector<uint32_t> rows(size);
+  auto src = ::create_strvec(size);
+  unsigned int cores = std::thread::hardware_concurrency();
+  ThreadPool pool(cores);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    radix_hash::radix_index_par<std::string,uint64_t>(src.begin(), src.end(),
+                                                      hashes.data(),
+                                                      rows.data(), pool);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+  state.SetComplexityN(state.range(0));
+}
+
 static void BM_radix_non_inplace_seq(benchmark::State& state) {
   int size = state.range(0);
   std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(size);
@@ -256,6 +311,57 @@ static void BM_radix_inplace_par(benchmark::State& state) {
 }
 
 
+static void BM_scatter_int(benchmark::State& state, ScatterMode mode) {
+  std::size_t size = state.range(0);
+  std::vector<std::tuple<std::size_t, uint64_t, uint64_t>> dst(size);
+  std::vector<std::pair<uint64_t, uint64_t>> src(size);
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> distribution;
+  struct rusage u_before, u_after;
+
+  for (std::size_t i = 0; i < size; i++) {
+    src[i] = std::make_pair(distribution(generator), i);
+  }
+  getrusage(RUSAGE_SELF, &u_before);
+
+  RESET_ACC_COUNTERS;
+  for (auto _ : state) {
+    START_COUNTERS;
+    radix_hash::radix_non_inplace_par<uint64_t,uint64_t>(src.begin(), src.end(),
+                                                         dst.begin(), cores,
+                                                         optimal_partition(size),
+                                                         mode);
+    ACCUMULATE_COUNTERS;
+  }
+  REPORT_COUNTERS(state);
+
+  getrusage(RUSAGE_SELF, &u_after);
+
+  state.SetComplexityN(state.range(0));
+  state.counters["Minor"] = u_after.ru_minflt - u_before.ru_minflt;
+  state.counters["Major"] = u_after.ru_majflt - u_before.ru_majflt;
+  state.counters["Swap"] = u_after.ru_nswap - u_before.ru_nswap;
+}
+
+static void BM_scatter_int_direct(benchmark::State& state) {
+  BM_scatter_int(state, kScatterDirect);
+}
+
+static void BM_scatter_int_streaming(benchmark::State& state) {
+  BM_scatter_int(state, kScatterStreaming);
+}
+
+// 10M to 1B tuples, where dst no longer fits in any cache.
+static void ScatterArguments(benchmark::internal::Benchmark* b) {
+  int64_t max = 1000*1000*1000;
+  for (int64_t i = 10*1000*1000; i <= max; i*=10) {
+    b->Args({i});
+    if (i < max)
+      b->Args({i*5});
+  }
+}
+
 BENCHMARK(BM_qsort_string)->Apply(RadixArguments)
 ->Complexity(benchmark::oN)->UseRealTime();
 BENCHMARK(BM_tbb_sort_string)->Apply(RadixArguments)
@@ -265,6 +371,11 @@ BENCHMARK(BM_pdqsort_string)->Apply(RadixArguments)
 BENCHMARK(BM_radix_non_inplace_par)->Apply(RadixArguments)
 ->Complexity(benchmark::oN)->UseRealTime();
 
+BENCHMARK(BM_radix_index_par)->Apply(RadixArguments)
+->Complexity(benchmark::oN)->UseRealTime();
+BENCHMARK(BM_radix_index_par_no_gather)->Apply(RadixArguments)
+->Complexity(benchmark::oN)->UseRealTime();
+
 BENCHMARK(BM_radix_non_inplace_seq)->Apply(RadixArguments)
 ->Complexity(benchmark::oN)->UseRealTime();
 
@@ -274,4 +385,9 @@ BENCHMARK(BM_radix_inplace_seq)->Apply(RadixArguments)
 BENCHMARK(BM_radix_inplace_par)->Apply(RadixArguments)
 ->Complexity(benchmark::oN)->UseRealTime();
 
+BENCHMARK(BM_scatter_int_direct)->Apply(ScatterArguments)
+->Complexity(benchmark::oN)->UseRealTime();
+BENCHMARK(BM_scatter_int_streaming)->Apply(ScatterArguments)
+->Complexity(benchmark::oN)->UseRealTime();
+
 BENCHMARK_MAIN();
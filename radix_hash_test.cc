@@ -17,6 +17,7 @@
 #include "radix_hash.h"
 #include "gtest/gtest.h"
 #include <vector>
+#include <deque>
 #include <string>
 #include <random>
 
@@ -119,6 +120,188 @@ TEST(radix_non_inplace_par, multi_pass_large_num3) {
   }
 }
 
+TEST(radix_non_inplace_par, thread_pool_reuse) {
+  int size = 12345;
+  std::vector<std::pair<int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> dst(size);
+  ThreadPool pool(4);
+  for (int i = size; i > 0; i--) {
+    src.push_back(std::make_pair(i, i));
+  }
+  for (int round = 0; round < 3; round++) {
+    radix_hash::radix_non_inplace_par<int,int,identity_hash>(src.begin(), src.end(), dst.begin(), pool);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(i + 1, std::get<0>(dst[i]));
+    }
+  }
+}
+
+TEST(radix_non_inplace_par, streaming_scatter) {
+  int size = 1 << 18;
+  std::vector<std::pair<int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> direct(size);
+  std::vector<std::tuple<std::size_t, int, int>> streamed(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution;
+  unsigned int cores = std::thread::hardware_concurrency();
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(distribution(generator), i));
+  }
+  radix_hash::radix_non_inplace_par<int,int>(src.begin(), src.end(), direct.begin(),
+                                             cores, 10);
+  radix_hash::radix_non_inplace_par<int,int>(src.begin(), src.end(), streamed.begin(),
+                                             cores, 10,
+                                             radix_hash::kScatterStreaming);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(direct[i], streamed[i]);
+  }
+}
+
+TEST(radix_non_inplace_par, streaming_scatter_deque) {
+  // A deque is not contiguous, streaming falls back to direct stores.
+  int size = 1 << 16;
+  std::vector<std::pair<int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> direct(size);
+  std::deque<std::tuple<std::size_t, int, int>> streamed(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution;
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(distribution(generator), i));
+  }
+  radix_hash::radix_non_inplace_par<int,int>(src.begin(), src.end(), direct.begin(),
+                                             2, 8);
+  radix_hash::radix_non_inplace_par<int,int>(src.begin(), src.end(), streamed.begin(),
+                                             2, 8,
+                                             radix_hash::kScatterStreaming);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(direct[i], streamed[i]);
+  }
+}
+
+TEST(radix_non_inplace_par, streaming_scatter_string) {
+  // std::string is not trivially copyable, streaming falls back to direct.
+  std::vector<std::pair<std::string, uint64_t>> src;
+  std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(1000);
+  for (int i = 0; i < 1000; i++) {
+    src.push_back(std::make_pair(std::to_string(i), i));
+  }
+  radix_hash::radix_non_inplace_par<std::string,uint64_t>(src.begin(), src.end(),
+                                                          dst.begin(), 2, 6,
+                                                          radix_hash::kScatterStreaming);
+  EXPECT_TRUE(std::is_sorted(dst.begin(), dst.end(), str_tuple_cmp));
+}
+
+struct counting_hash
+{
+  static std::atomic_int calls;
+  std::size_t operator()(const int& k) const {
+    calls++;
+    return k;
+  }
+};
+std::atomic_int counting_hash::calls(0);
+
+TEST(radix_non_inplace_par, hash_once) {
+  int size = 12345;
+  std::vector<std::pair<int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> dst(size);
+  for (int i = size; i > 0; i--) {
+    src.push_back(std::make_pair(i, i));
+  }
+  counting_hash::calls = 0;
+  radix_hash::radix_non_inplace_par<int,int,counting_hash>(src.begin(), src.end(), dst.begin(), 4, 6);
+  EXPECT_EQ(size, counting_hash::calls);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(i + 1, std::get<0>(dst[i]));
+  }
+}
+
+TEST(radix_non_inplace_par, prehashed_input) {
+  int size = 12345;
+  std::vector<std::tuple<std::size_t, int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> dst(size);
+  for (int i = size; i > 0; i--) {
+    // The hash is deliberately unrelated to the key.
+    src.push_back(std::make_tuple((std::size_t)(size - i), i, i));
+  }
+  radix_hash::radix_non_inplace_par<int,int,radix_hash::Prehashed>(src.begin(), src.end(), dst.begin(), 4, 6);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(i, std::get<0>(dst[i]));
+    EXPECT_EQ(size - i, std::get<1>(dst[i]));
+  }
+}
+
+TEST(radix_non_inplace_par, tuple_input) {
+  // Tuple-like items other than pairs hash std::get<0> with Hash.
+  int size = 12345;
+  std::vector<std::tuple<int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> dst(size);
+  for (int i = size; i > 0; i--) {
+    src.push_back(std::make_tuple(i, -i));
+  }
+  counting_hash::calls = 0;
+  radix_hash::radix_non_inplace_par<int,int,counting_hash>(src.begin(), src.end(), dst.begin(), 4, 6);
+  EXPECT_EQ(size, counting_hash::calls);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(i + 1, std::get<1>(dst[i]));
+    EXPECT_EQ(-(i + 1), std::get<2>(dst[i]));
+  }
+}
+
+TEST(radix_non_inplace_par, runs_input) {
+  // Runs of different sizes, one empty, sort like their concatenation.
+  std::vector<std::vector<std::pair<int, int>>> runs(4);
+  std::vector<std::pair<int, int>> all;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution;
+  for (int r = 0; r < 4; r++) {
+    for (int i = 0; i < r * 5000; i++) {
+      runs[r].push_back(std::make_pair(distribution(generator), i));
+      all.push_back(runs[r].back());
+    }
+  }
+  std::vector<std::tuple<std::size_t, int, int>> expected(all.size());
+  std::vector<std::tuple<std::size_t, int, int>> dst(all.size());
+  radix_hash::radix_non_inplace_par<int,int>(all.begin(), all.end(), expected.begin(), 1, 8);
+  counting_hash::calls = 0;
+  radix_hash::radix_non_inplace_runs<int,int,counting_hash>(&runs, dst.begin(), nullptr, 8);
+  EXPECT_EQ(static_cast<int>(all.size()), counting_hash::calls);
+  radix_hash::radix_non_inplace_runs<int,int>(&runs, dst.begin(), nullptr, 8);
+  EXPECT_EQ(expected, dst);
+}
+
+TEST(prefix_sum_par, matches_serial_scan) {
+  // More threads than partitions leaves some blocks empty.
+  for (int num_threads : {1, 3, 7, 12}) {
+    int partitions = 8;
+    std::vector<std::size_t> counters(partitions * num_threads);
+    std::vector<std::size_t> expected(counters.size());
+    std::vector<std::size_t> block_sums(num_threads);
+    std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < counters.size(); i++)
+      counters[i] = (i * 7919) % 13;
+    for (int i = 0; i < partitions; i++) {
+      for (int j = 0; j < num_threads; j++) {
+        expected[j*partitions + i] = sum;
+        sum += counters[j*partitions + i];
+      }
+    }
+    ThreadBarrier barrier(num_threads);
+    run_on_threads(nullptr, num_threads, [&](int thread_id) {
+        radix_hash::prefix_sum_par(counters.data(), partitions, thread_id,
+                                   num_threads, &barrier, block_sums.data(),
+                                   &indexes);
+      });
+    EXPECT_EQ(expected, counters);
+    for (int i = 0; i < partitions; i++) {
+      EXPECT_EQ(expected[i], indexes[i].first);
+      EXPECT_EQ(i + 1 < partitions ? expected[i + 1] : sum,
+                indexes[i].second);
+    }
+  }
+}
+
 TEST(radix_inplace_seq_test, full_sort) {
   std::vector<std::tuple<std::size_t, int, int>> dst;
   for (int i = 4; i > -1; i--) {
@@ -260,3 +443,90 @@ TEST(radix_inplace_par_test, random_num) {
     EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(input[i]));
   }
 }
+
+TEST(radix_inplace_par_test, thread_pool_reuse) {
+  int size = 1<<16;
+  std::vector<std::tuple<std::size_t, int, int>> input;
+  std::vector<std::tuple<std::size_t, int, int>> work;
+  std::vector<std::tuple<std::size_t, int, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  ThreadPool pool(4);
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_tuple(r, i, i));
+  }
+  std_sorted = input;
+  std::sort(std_sorted.begin(), std_sorted.end(), tuple_cmp);
+
+  for (int round = 0; round < 3; round++) {
+    work = input;
+    radix_hash::radix_inplace_par(work.begin(), size, pool);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(work[i]));
+    }
+  }
+}
+
+TEST(radix_inplace_par_test, many_threads) {
+  int size = 100003;
+  std::vector<std::tuple<std::size_t, int, int>> input;
+  std::vector<std::tuple<std::size_t, int, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_tuple(r, i, i));
+  }
+  std_sorted = input;
+  std::sort(std_sorted.begin(), std_sorted.end(), tuple_cmp);
+
+  for (int threads = 2; threads <= 16; threads *= 2) {
+    std::vector<std::tuple<std::size_t, int, int>> work = input;
+    radix_hash::radix_inplace_par(work.begin(), size, threads, 11);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(work[i]));
+    }
+  }
+}
+
+TEST(radix_non_inplace_par, skewed_keys) {
+  // Identity hashed small keys all land in the first top level partition,
+  // the recursive phase has to split it among the threads.
+  int size = 1<<17;
+  std::vector<std::pair<int, int>> src;
+  std::vector<std::tuple<std::size_t, int, int>> dst(size);
+  std::vector<std::tuple<std::size_t, int, int>> std_sorted;
+  std::default_random_engine generator;
+  std::geometric_distribution<int> distribution(0.001);
+  for (int i = 0; i < size; i++) {
+    int k = distribution(generator);
+    src.push_back(std::make_pair(k, i));
+    std_sorted.push_back(std::make_tuple(k, k, i));
+  }
+  std::sort(std_sorted.begin(), std_sorted.end(), tuple_cmp);
+
+  radix_hash::radix_non_inplace_par<int,int,identity_hash>(src.begin(), src.end(), dst.begin(), 8, 8);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
+  }
+}
+
+TEST(radix_inplace_par_test, skewed_keys) {
+  int size = 1<<17;
+  std::vector<std::tuple<std::size_t, int, int>> input;
+  std::vector<std::tuple<std::size_t, int, int>> std_sorted;
+  std::default_random_engine generator;
+  std::geometric_distribution<int> distribution(0.001);
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_tuple(r, i, i));
+  }
+  std_sorted = input;
+  std::sort(std_sorted.begin(), std_sorted.end(), tuple_cmp);
+
+  radix_hash::radix_inplace_par(input.begin(), size, 8, 8);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(input[i]));
+  }
+}
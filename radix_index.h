@@ -0,0 +1,408 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RADIX_INDEX_H
+#define RADIX_INDEX_H 1
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <assert.h>
+#include "radix_hash.h"
+#include "thread_barrier.h"
+#include "thread_pool.h"
+#include "work_stealing.h"
+
+// Structure of arrays variant of the radix hash sort. Instead of moving
+// (hash, key, value) tuples through every pass, only a dense hash array
+// and a parallel array of row indexes are permuted; the payload is
+// gathered once at the end, or not at all when the caller only needs the
+// permutation.
+namespace radix_hash {
+
+template<typename Row>
+static inline
+void index_insertion_outer(std::size_t* hashes,
+                           Row* rows,
+                           std::size_t idx_begin,
+                           std::size_t idx_end) {
+  std::size_t h;
+  Row r;
+  for (std::size_t idx = idx_begin + 1; idx < idx_end; idx++) {
+    h = hashes[idx];
+    r = rows[idx];
+    std::size_t j = idx;
+    while (j > idx_begin &&
+           (hashes[j-1] > h || (hashes[j-1] == h && rows[j-1] > r))) {
+      hashes[j] = hashes[j-1];
+      rows[j] = rows[j-1];
+      j--;
+    }
+    hashes[j] = h;
+    rows[j] = r;
+  }
+}
+
+// Counting sort [s_begin, s_end) on the partition_bits below mask_bits,
+// leaving the bucket ends in ends.
+template<typename Row>
+static inline
+void index_partition(std::size_t* hashes,
+                     Row* rows,
+                     std::size_t s_begin,
+                     std::size_t s_end,
+                     int mask_bits,
+                     int partition_bits,
+                     std::size_t* counters,
+                     std::size_t* ends) {
+  std::size_t mask, idx_i, idx_j, tmp_h;
+  int partitions, shift, iter, idx_c;
+  Row tmp_r;
+
+  partitions = 1 << partition_bits;
+  mask = mask_bits >= 64 ? ~0ULL : (1ULL << mask_bits) - 1ULL;
+  shift = mask_bits < partition_bits ? 0 : mask_bits - partition_bits;
+
+  for (int i = 0; i < partitions; i++)
+    counters[i] = 0;
+  for (std::size_t i = s_begin; i < s_end; i++) {
+    counters[(hashes[i] & mask) >> shift]++;
+  }
+  // Reuse counters as the bucket heads of the permutation, which end up
+  // at the bucket ends.
+  idx_i = s_begin;
+  for (int i = 0; i < partitions; i++) {
+    ends[i] = idx_i + counters[i];
+    counters[i] = idx_i;
+    idx_i = ends[i];
+  }
+
+  iter = 0;
+  while (iter < partitions) {
+    idx_i = counters[iter];
+    if (idx_i >= ends[iter]) {
+      iter++;
+      continue;
+    }
+    idx_c = static_cast<int>((hashes[idx_i] & mask) >> shift);
+    if (idx_c == iter) {
+      counters[iter]++;
+      continue;
+    }
+    tmp_h = hashes[idx_i];
+    tmp_r = rows[idx_i];
+    do {
+      idx_c = static_cast<int>((tmp_h & mask) >> shift);
+      idx_j = counters[idx_c]++;
+      std::swap(hashes[idx_j], tmp_h);
+      std::swap(rows[idx_j], tmp_r);
+    } while (idx_j > idx_i);
+  }
+}
+
+// Buckets whose hash bits are used up hold a single hash value; order
+// them by row so ties always come out in row order.
+template<typename Row>
+static inline
+void index_sort_rows(Row* rows,
+                     std::size_t s_begin,
+                     const std::size_t* ends,
+                     int partitions) {
+  for (int i = 0; i < partitions; i++) {
+    if (ends[i] - s_begin > 1)
+      std::sort(rows + s_begin, rows + ends[i]);
+    s_begin = ends[i];
+  }
+}
+
+// One level of the index sort: finishes a small range, or one whose hash
+// bits run out at this digit, and returns 0; otherwise partitions it into
+// buckets ending at ends and returns the bits left below the digit.
+template<typename Row>
+int index_split(std::size_t* hashes,
+                Row* rows,
+                std::size_t s_begin,
+                std::size_t s_end,
+                int mask_bits,
+                int partition_bits,
+                std::size_t insertion_limit,
+                std::size_t* counters,
+                std::size_t* ends) {
+  if (s_end - s_begin < 2)
+    return 0;
+  // Partition too small, use insertion sort instead.
+  if (s_end - s_begin < insertion_limit) {
+    // The sorting network leaves equal hashes for insertion sort to put
+    // in row order.
+    small_sort(hashes, rows, s_begin, s_end);
+    index_insertion_outer(hashes, rows, s_begin, s_end);
+    return 0;
+  }
+  index_partition(hashes, rows, s_begin, s_end, mask_bits, partition_bits,
+                  counters, ends);
+  if (mask_bits - partition_bits <= 0) {
+    index_sort_rows(rows, s_begin, ends, 1 << partition_bits);
+    return 0;
+  }
+  return mask_bits - partition_bits;
+}
+
+// Sorts [begin, end) on the explicit stack of scratch, handing buckets to
+// queues when there are any.
+template<typename Row>
+void index_sort_range(std::size_t* hashes,
+                      Row* rows,
+                      std::size_t begin,
+                      std::size_t end,
+                      int mask_bits,
+                      int partition_bits,
+                      MsdScratch* scratch,
+                      SortTaskQueues* queues,
+                      int thread_id) {
+  std::size_t insertion_limit = insertion_threshold(partition_bits);
+  msd_sort(begin, end, mask_bits, false, scratch, queues, thread_id,
+           [&](std::size_t s_begin, std::size_t s_end, int bits, bool*,
+               std::size_t* ends) {
+             return index_split(hashes, rows, s_begin, s_end, bits,
+                                partition_bits, insertion_limit,
+                                scratch->counters(), ends);
+           });
+}
+
+// Recursive phase of radix_index_par, scheduled like bf6_helper_p.
+template<typename Row>
+void index_helper_p(std::size_t* hashes,
+                    Row* rows,
+                    int partition_bits,
+                    SortTaskQueues* queues,
+                    int thread_id) {
+  MsdScratch scratch(queues->mask_bits(), partition_bits);
+  SortTask task;
+
+  while (queues->next(thread_id, &task)) {
+    index_sort_range(hashes, rows, task.begin, task.end, task.mask_bits,
+                     partition_bits, &scratch, queues, thread_id);
+    queues->finish();
+  }
+}
+
+template<typename Input,
+  typename Row,
+  typename BidirectionalIterator>
+  void radix_index_worker(BidirectionalIterator begin,
+                          BidirectionalIterator end,
+                          std::size_t first_row,
+                          std::size_t* hashes,
+                          Row* rows,
+                          int thread_id,
+                          int thread_num,
+                          ThreadBarrier* barrier,
+                          std::vector<std::size_t>* shared_counters,
+                          std::vector<std::size_t>* block_sums,
+                          std::vector<std::pair<std::size_t,std::size_t>>* indexes,
+                          int partitions,
+                          int shift) {
+  std::size_t h, pos, dst_idx;
+  std::size_t* row = &(*shared_counters)[thread_id*partitions];
+  LocalCounters counters(partitions);
+  std::vector<std::size_t> local_hashes(std::distance(begin, end));
+
+  pos = 0;
+  for (auto iter = begin; iter != end; ++iter, ++pos) {
+    h = Input::hash(*iter);
+    local_hashes[pos] = h;
+    counters[h>>shift]++;
+  }
+
+  counters.publish(row);
+  prefix_sum_par(shared_counters->data(), partitions, thread_id,
+                 thread_num, barrier, block_sums->data(), indexes);
+  counters.fetch(row);
+
+  for (pos = 0; pos < local_hashes.size(); pos++) {
+    h = local_hashes[pos];
+    dst_idx = counters[h>>shift]++;
+    hashes[dst_idx] = h;
+    rows[dst_idx] = static_cast<Row>(first_row + pos);
+  }
+}
+
+// Sorts hashes[0, input_num) in place and applies the same permutation to
+// rows. Ties are broken by row.
+template<typename Row>
+void radix_index_seq(std::size_t* hashes,
+                     Row* rows,
+                     std::size_t input_num,
+                     int partition_bits) {
+  MsdScratch scratch(64, partition_bits);
+  index_sort_range(hashes, rows, 0, input_num, 64, partition_bits, &scratch,
+                   nullptr, 0);
+}
+
+template<typename Row>
+void radix_index_seq(std::size_t* hashes,
+                     Row* rows,
+                     std::size_t input_num) {
+  radix_index_seq(hashes, rows, input_num, optimal_partition(input_num));
+}
+
+// Hashes every key of [begin, end) once and writes the sorted hashes to
+// hashes[0, n) and the input position of each one to rows[0, n). Row is
+// uint32_t or uint64_t; a 32 bit row array only works for inputs with
+// fewer than 2^32 items. Items are (key, value) pairs, or (hash, key,
+// value) tuples with Hash = Prehashed, like radix_non_inplace_par.
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Row,
+  typename BidirectionalIterator>
+  void radix_index_par(BidirectionalIterator begin,
+                       BidirectionalIterator end,
+                       std::size_t* hashes,
+                       Row* rows,
+                       ThreadPool* pool,
+                       int num_threads,
+                       int partition_bits) {
+  static_assert(std::is_unsigned<Row>::value, "Row must be an unsigned integer type.");
+  typedef HashInput<Hash,
+    typename std::iterator_traits<BidirectionalIterator>::value_type> Input;
+  int shift, partitions, new_mask_bits;
+  std::size_t input_num, thread_partition;
+  ThreadBarrier barrier(num_threads);
+
+  partitions = 1 << partition_bits;
+  input_num = std::distance(begin, end);
+  thread_partition = input_num / num_threads;
+  assert(input_num - 1 <= std::numeric_limits<Row>::max() || input_num == 0);
+
+  shift = 64 - partition_bits;
+  new_mask_bits = 64 - partition_bits;
+
+  std::vector<std::size_t> shared_counters(partitions*num_threads);
+  std::vector<std::size_t> block_sums(num_threads);
+  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+  SortTaskQueues queues(num_threads, &indexes, new_mask_bits);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      BidirectionalIterator t_begin = begin + thread_id * thread_partition;
+      BidirectionalIterator t_end = thread_id == num_threads - 1 ?
+        end : begin + (thread_id + 1) * thread_partition;
+      radix_index_worker<Input>(t_begin, t_end, thread_id * thread_partition,
+                                hashes, rows, thread_id, num_threads,
+                                &barrier, &shared_counters, &block_sums,
+                                &indexes, partitions, shift);
+      barrier.wait();
+      index_helper_p(hashes, rows, partition_bits, &queues, thread_id);
+    });
+}
+
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Row,
+  typename BidirectionalIterator>
+  void radix_index_par(BidirectionalIterator begin,
+                       BidirectionalIterator end,
+                       std::size_t* hashes,
+                       Row* rows,
+                       int num_threads,
+                       int partition_bits) {
+  radix_index_par<Key,Value,Hash>(begin, end, hashes, rows, nullptr,
+                                  tuned_threads(num_threads,
+                                                std::distance(begin, end)),
+                                  partition_bits);
+}
+
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Row,
+  typename BidirectionalIterator>
+  void radix_index_par(BidirectionalIterator begin,
+                       BidirectionalIterator end,
+                       std::size_t* hashes,
+                       Row* rows,
+                       int num_threads) {
+  radix_index_par<Key,Value,Hash>(begin, end, hashes, rows, num_threads,
+                                  optimal_partition(std::distance(begin, end)));
+}
+
+template <typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Row,
+  typename BidirectionalIterator>
+  void radix_index_par(BidirectionalIterator begin,
+                       BidirectionalIterator end,
+                       std::size_t* hashes,
+                       Row* rows,
+                       ThreadPool& pool) {
+  radix_index_par<Key,Value,Hash>(begin, end, hashes, rows, &pool,
+                                  pool.size(),
+                                  optimal_partition(std::distance(begin, end)));
+}
+
+// Materializes dst[i] = (hashes[i], key, value) of item src[rows[i]] for
+// i in [0, input_num), splitting the work over num_threads threads. Hash
+// is the one given to radix_index_par; only Prehashed changes the items.
+template <typename Hash = void,
+  typename RandomAccessIterator,
+  typename Row,
+  typename OutputIterator>
+  void gather_rows(RandomAccessIterator src,
+                   const std::size_t* hashes,
+                   const Row* rows,
+                   std::size_t input_num,
+                   OutputIterator dst,
+                   ThreadPool* pool,
+                   int num_threads) {
+  typedef HashInput<Hash,
+    typename std::iterator_traits<RandomAccessIterator>::value_type> Input;
+  std::size_t thread_partition = input_num / num_threads;
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_begin = thread_id * thread_partition;
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : t_begin + thread_partition;
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        std::get<0>(dst[i]) = hashes[i];
+        std::get<1>(dst[i]) = Input::key(src[rows[i]]);
+        std::get<2>(dst[i]) = Input::value(src[rows[i]]);
+      }
+    });
+}
+
+template <typename Hash = void,
+  typename RandomAccessIterator,
+  typename Row,
+  typename OutputIterator>
+  void gather_rows(RandomAccessIterator src,
+                   const std::size_t* hashes,
+                   const Row* rows,
+                   std::size_t input_num,
+                   OutputIterator dst,
+                   int num_threads) {
+  gather_rows<Hash>(src, hashes, rows, input_num, dst, nullptr,
+              tuned_threads(num_threads, input_num));
+}
+
+} // namespace radix_hash
+
+#endif
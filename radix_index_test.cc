@@ -0,0 +1,115 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "radix_index.h"
+#include "gtest/gtest.h"
+#include <vector>
+#include <string>
+#include <random>
+
+TEST(radix_index_seq_test, random_num) {
+  int size = 100003;
+  std::vector<std::size_t> hashes, std_sorted;
+  std::vector<uint32_t> rows;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  for (int i = 0; i < size; i++) {
+    hashes.push_back(distribution(generator) >> (i % 2 ? 0 : 40));
+    rows.push_back(i);
+  }
+  std::vector<std::size_t> input = hashes;
+  std_sorted = hashes;
+  std::sort(std_sorted.begin(), std_sorted.end());
+
+  radix_hash::radix_index_seq(hashes.data(), rows.data(), size);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std_sorted[i], hashes[i]);
+    EXPECT_EQ(input[rows[i]], hashes[i]);
+  }
+}
+
+TEST(radix_index_par_test, string_keys) {
+  int size = 1<<17;
+  std::vector<std::pair<std::string, uint64_t>> src;
+  std::vector<std::size_t> hashes(size);
+  std::vector<uint32_t> rows(size);
+  std::vector<std::tuple<std::size_t, std::string, uint64_t>> dst(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, size / 4);
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  }
+
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    radix_hash::radix_index_par<std::string,uint64_t>(src.begin(), src.end(),
+                                                      hashes.data(),
+                                                      rows.data(), threads);
+    radix_hash::gather_rows(src.begin(), hashes.data(), rows.data(), size,
+                            dst.begin(), threads);
+    for (int i = 0; i < size; i++) {
+      if (i > 0) {
+        ASSERT_LE(hashes[i-1], hashes[i]);
+        // Equal hashes keep input order.
+        if (hashes[i-1] == hashes[i]) {
+          ASSERT_LT(rows[i-1], rows[i]);
+        }
+      }
+      ASSERT_EQ(std::hash<std::string>{}(std::get<1>(dst[i])), hashes[i]);
+      ASSERT_EQ(src[rows[i]].first, std::get<1>(dst[i]));
+      ASSERT_EQ(src[rows[i]].second, std::get<2>(dst[i]));
+    }
+  }
+}
+
+TEST(radix_index_par_test, wide_rows_thread_pool) {
+  int size = 50000;
+  std::vector<std::tuple<std::size_t, int, int>> src;
+  std::vector<std::size_t> hashes(size);
+  std::vector<uint64_t> rows(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  ThreadPool pool(4);
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_tuple(distribution(generator), i, -i));
+  }
+
+  radix_hash::radix_index_par<int,int,radix_hash::Prehashed>(
+      src.begin(), src.end(), hashes.data(), rows.data(), pool);
+  for (int i = 0; i < size; i++) {
+    if (i > 0) {
+      ASSERT_LE(hashes[i-1], hashes[i]);
+    }
+    EXPECT_EQ(std::get<0>(src[rows[i]]), hashes[i]);
+  }
+}
+
+TEST(radix_index_seq_test, equal_hashes_keep_row_order) {
+  int size = 10000;
+  std::vector<std::size_t> hashes;
+  std::vector<uint32_t> rows;
+  for (int i = 0; i < size; i++) {
+    hashes.push_back(i % 3);
+    rows.push_back(size - i);
+  }
+
+  radix_hash::radix_index_seq(hashes.data(), rows.data(), size, 8);
+  for (int i = 1; i < size; i++) {
+    ASSERT_LE(hashes[i-1], hashes[i]);
+    if (hashes[i-1] == hashes[i]) {
+      ASSERT_LT(rows[i-1], rows[i]);
+    }
+  }
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RADIX_KEY_H
+#define RADIX_KEY_H 1
+
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace radix_hash {
+
+// Order preserving map from a sort key to the unsigned integer the radix
+// passes look at: a < b implies encode(a) < encode(b). Only the encoded
+// bits are used for bucketing; the stored key is never modified.
+template<typename Key, typename Enable = void>
+struct RadixKey;
+
+template<typename Key>
+struct RadixKey<Key,
+  typename std::enable_if<std::is_unsigned<Key>::value>::type> {
+  typedef Key Bits;
+  static Bits encode(Key key) {
+    return key;
+  }
+};
+
+// Two's complement with the sign bit flipped orders like unsigned.
+template<typename Key>
+struct RadixKey<Key,
+  typename std::enable_if<std::is_integral<Key>::value &&
+                          std::is_signed<Key>::value>::type> {
+  typedef typename std::make_unsigned<Key>::type Bits;
+  static Bits encode(Key key) {
+    return static_cast<Bits>(static_cast<Bits>(key) ^
+                             (Bits(1) << (sizeof(Key) * 8 - 1)));
+  }
+};
+
+// IEEE-754 total order: negative numbers have all bits flipped, positive
+// ones only the sign bit. The result is
+//   -NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN
+// so NaNs with the sign bit clear, such as quiet_NaN(), sort last.
+template<typename Key>
+struct RadixKey<Key,
+  typename std::enable_if<std::is_floating_point<Key>::value>::type> {
+  static_assert(sizeof(Key) == 4 || sizeof(Key) == 8,
+                "Only 32 and 64 bit floating point keys are supported.");
+  typedef typename std::conditional<sizeof(Key) == 4,
+    uint32_t, uint64_t>::type Bits;
+  static Bits encode(Key key) {
+    const int top = sizeof(Key) * 8 - 1;
+    Bits bits, flip;
+    std::memcpy(&bits, &key, sizeof(Key));
+    // All ones when the sign is set, otherwise only the sign bit. Keys
+    // of mixed sign would mispredict a branch half of the time.
+    flip = static_cast<Bits>(0 - (bits >> top)) | (Bits(1) << top);
+    return bits ^ flip;
+  }
+};
+
+template<typename Key>
+static inline typename RadixKey<Key>::Bits radix_bits(Key key) {
+  return RadixKey<Key>::encode(key);
+}
+
+// The sort key of an item: the first element of pairs and tuples, or the
+// item itself when a range holds bare keys.
+template<typename Key>
+static inline
+typename std::enable_if<std::is_arithmetic<Key>::value, const Key&>::type
+item_key(const Key& key) {
+  return key;
+}
+
+template<typename First, typename Second>
+static inline const First& item_key(const std::pair<First, Second>& item) {
+  return item.first;
+}
+
+template<typename... Types>
+static inline
+const typename std::tuple_element<0, std::tuple<Types...>>::type&
+item_key(const std::tuple<Types...>& item) {
+  return std::get<0>(item);
+}
+
+} // namespace radix_hash
+
+#endif
@@ -28,19 +28,23 @@
 #include <assert.h>
 #include <atomic>
 #include <thread>
-#include <mutex>
+#include <limits>
 #include "thread_barrier.h"
+#include "thread_pool.h"
 #include "radix_hash.h"
+#include "work_stealing.h"
+#include "radix_key.h"
+#include "small_sort.h"
 
 template<typename RandomAccessIterator, typename Key>
 static inline
 void rs1_insertion_inner(RandomAccessIterator dst,
                          std::size_t idx,
                          std::size_t limit) {
-  Key h1, h2;
+  typename radix_hash::RadixKey<Key>::Bits h1, h2;
   while (idx > limit) {
-    h1 = std::get<0>(dst[idx]);
-    h2 = std::get<0>(dst[idx-1]);
+    h1 = radix_hash::radix_bits(radix_hash::item_key(dst[idx]));
+    h2 = radix_hash::radix_bits(radix_hash::item_key(dst[idx-1]));
     if (h1 < h2) {
       std::swap(dst[idx], dst[idx-1]);
       idx--;
@@ -61,329 +65,297 @@ void rs1_insertion_outer(RandomAccessIterator dst,
   }
 }
 
-template <typename Key,
-  typename Value,
-  typename RandomAccessIterator>
-  void rs1_helper_s(RandomAccessIterator dst,
-                    const std::size_t (*super_indexes)[2],
-                    int mask_bits,
-                    int partition_bits) {
-  std::pair<Key, Value> tmp_bucket;
-  Key h, mask;
-  int partitions, sqrt_partitions, shift;
-  std::size_t idx_i, idx_j, s_begin, s_end;
-  int new_mask_bits, iter, idx_c;
-
-  partitions = 1 << partition_bits;
-  sqrt_partitions = 1 << (partition_bits / 2);
-  mask = (1ULL << mask_bits);
-  mask -= 1;
-  shift = mask_bits < partition_bits ? 0 : mask_bits - partition_bits;
+// Bit length of x, 0 for 0.
+template<typename Bits>
+static inline int rs1_bit_length(Bits x) {
+  return x ? 64 - __builtin_clzll(static_cast<unsigned long long>(x)) : 0;
+}
 
-  std::size_t counters[partitions];
-  std::size_t indexes[partitions][2];
+// The low `bits` bits set.
+template<typename Bits>
+static inline Bits rs1_low_mask(int bits) {
+  return bits >= static_cast<int>(sizeof(Bits)*8) ?
+    static_cast<Bits>(~Bits(0)) : static_cast<Bits>((Bits(1) << bits) - 1);
+}
 
-  for (int s = 0; s < partitions; s++) {
-    s_begin = super_indexes[s][0];
-    s_end = super_indexes[s][1];
-    if (s_end - s_begin < 2)
-      continue;
-    // Partition too small, use insertion sort instead.
-    if (s_end - s_begin < static_cast<std::size_t>(sqrt_partitions)) {
-      rs1_insertion_outer<RandomAccessIterator, Key>(dst, s_begin, s_end);
-      continue;
-    }
-    // Setup counters for counting sort.
-    for (int i = 0; i < partitions; i++)
-      counters[i] = 0;
-    indexes[0][0] = s_begin;
-    for (std::size_t i = s_begin; i < s_end; i++) {
-      h = std::get<0>(dst[i]);
-      counters[(h & mask) >> shift]++;
-    }
-    for (int i = 0; i < partitions - 1; i++) {
-      indexes[i][1] = indexes[i+1][0] = indexes[i][0] + counters[i];
-    }
-    indexes[partitions-1][1] = indexes[partitions-1][0]
-      + counters[partitions-1];
-
-    new_mask_bits = mask_bits - partition_bits;
-    iter = 0;
-    while (iter < partitions) {
-      idx_i = indexes[iter][0];
-      if (idx_i >= indexes[iter][1]) {
-        iter++;
-        continue;
-      }
-      h = std::get<0>(dst[idx_i]);
-      idx_c = static_cast<int>((h & mask) >> shift);
-      if (idx_c == iter) {
-        indexes[iter][0]++;
-        continue;
-      }
-      tmp_bucket = std::move(dst[idx_i]);
-      do {
-        h = std::get<0>(tmp_bucket);
-        idx_c = static_cast<int>((h & mask) >> shift);
-        idx_j = indexes[idx_c][0]++;
-        std::swap(dst[idx_j], tmp_bucket);
-      } while (idx_j > idx_i);
-    }
+// OR and AND of the encoded keys in [begin, end). The bits where they differ are
+// the only ones the radix passes need to look at.
+template<typename Bits, typename Iterator>
+static inline void rs1_key_bits(Iterator begin,
+                                Iterator end,
+                                Bits* or_bits,
+                                Bits* and_bits) {
+  Bits h, ors = 0, ands = static_cast<Bits>(~Bits(0));
+  for (auto iter = begin; iter != end; ++iter) {
+    h = radix_hash::radix_bits(radix_hash::item_key(*iter));
+    ors |= h;
+    ands &= h;
+  }
+  *or_bits = ors;
+  *and_bits = ands;
+}
 
-    if (new_mask_bits <= 0) {
-      continue;
-    }
+// Counts the digit (h & mask) >> shift of dst[s_begin, s_end) and returns
+// the bits under mask that vary within the range.
+template<typename Bits, typename RandomAccessIterator>
+static inline Bits rs1_count(RandomAccessIterator dst,
+                             std::size_t s_begin,
+                             std::size_t s_end,
+                             Bits mask,
+                             int shift,
+                             std::size_t* counters,
+                             int partitions) {
+  uint64_t ors = 0, ands = ~0ULL;
+  for (int i = 0; i < partitions; i++)
+    counters[i] = 0;
+  radix_hash::count_digits(dst + s_begin, dst + s_end, shift, mask >> shift,
+                           counters, &ors, &ands);
+  return static_cast<Bits>(ors ^ ands) & mask;
+}
 
-    // Reset indexes
-    indexes[0][0] = s_begin;
-    for (int i = 1; i < partitions; i++) {
-      indexes[i][0] = indexes[i-1][1];
-    }
-    rs1_helper_s<Key,Value,RandomAccessIterator>
-      (dst, indexes, new_mask_bits, partition_bits);
+// Counts the highest digit of dst[s_begin, s_end) below *mask_bits that
+// is not constant within the range, lowering *mask_bits to its top.
+// Returns the bits below *mask_bits that vary, 0 if the range is sorted.
+template<typename Bits, typename RandomAccessIterator>
+static inline Bits rs1_count_varying(RandomAccessIterator dst,
+                                     std::size_t s_begin,
+                                     std::size_t s_end,
+                                     int* mask_bits,
+                                     int partition_bits,
+                                     std::size_t* counters) {
+  Bits varying;
+  int shift, top;
+  while (true) {
+    shift = *mask_bits < partition_bits ? 0 : *mask_bits - partition_bits;
+    varying = rs1_count<Bits>(dst, s_begin, s_end,
+                             rs1_low_mask<Bits>(*mask_bits), shift,
+                             counters, 1 << partition_bits);
+    top = rs1_bit_length(varying);
+    // Recount only when the whole digit was constant, i.e. every key
+    // landed in one bucket.
+    if (top == 0 || top > shift)
+      return varying;
+    *mask_bits = top;
   }
 }
 
+// One level of the in place sort of dst[s_begin, s_end) on its low
+// mask_bits bits. Small ranges are finished and 0 returned; otherwise the
+// range is permuted into the buckets of the highest digit that varies,
+// whose ends go to ends, and the bits left below it are returned, 0 when
+// those are constant too.
 template <typename Key,
-  typename Value,
   typename RandomAccessIterator>
-  void rs1_helper_p(RandomAccessIterator dst,
-                    const std::vector<std::pair<std::size_t, std::size_t>>& super_indexes,
-                    int mask_bits,
-                    int partition_bits,
-                    std::atomic_int* super_counter) {
-  std::pair<Key, Value> tmp_bucket;
-  Key h, mask;
-  int s_idx, partitions, sqrt_partitions, shift, new_mask_bits, iter, idx_c;
-  std::size_t idx_i, idx_j, s_begin, s_end;
+  int rs1_split(RandomAccessIterator dst,
+                std::size_t s_begin,
+                std::size_t s_end,
+                int mask_bits,
+                int partition_bits,
+                std::size_t insertion_limit,
+                std::size_t* counters,
+                std::size_t* ends) {
+  typename std::iterator_traits<RandomAccessIterator>::value_type
+    tmp_bucket;
+  typedef typename radix_hash::RadixKey<Key>::Bits Bits;
+  Bits h, mask, varying;
+  int partitions, shift, new_mask_bits, iter, idx_c;
+  std::size_t idx_i, idx_j;
 
+  if (s_end - s_begin < 2)
+    return 0;
+  // Partition too small, use a sorting network or insertion sort instead.
+  if (s_end - s_begin < insertion_limit) {
+    if (!radix_hash::small_sort(dst, s_begin, s_end))
+      rs1_insertion_outer<RandomAccessIterator, Key>(dst, s_begin, s_end);
+    return 0;
+  }
+  // Setup counters for counting sort.
   partitions = 1 << partition_bits;
-  sqrt_partitions = 1 << (partition_bits / 2);
-  mask = (1ULL << mask_bits);
-  mask -= 1;
+  varying = rs1_count_varying<Bits>(dst, s_begin, s_end, &mask_bits,
+                                    partition_bits, counters);
+  if (varying == 0)
+    return 0;
+  mask = rs1_low_mask<Bits>(mask_bits);
   shift = mask_bits < partition_bits ? 0 : mask_bits - partition_bits;
+  // Reuse counters as the bucket heads of the permutation, which end up
+  // at the bucket ends.
+  idx_i = s_begin;
+  for (int i = 0; i < partitions; i++) {
+    ends[i] = idx_i + counters[i];
+    counters[i] = idx_i;
+    idx_i = ends[i];
+  }
 
-  std::size_t counters[partitions];
-  std::size_t indexes[partitions][2];
-
-  s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
-
-  // TODO change s to a atomic variable and use a boolean to determine
-  // to use it or not.
-  while (s_idx < partitions) {
-    s_begin = super_indexes[s_idx].first;
-    s_end = super_indexes[s_idx].second;
-    if (s_end - s_begin < 2) {
-      s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
+  iter = 0;
+  while (iter < partitions) {
+    idx_i = counters[iter];
+    if (idx_i >= ends[iter]) {
+      iter++;
       continue;
     }
-    // Partition too small, use insertion sort instead.
-    if (s_end - s_begin < static_cast<std::size_t>(sqrt_partitions)) {
-      rs1_insertion_outer<RandomAccessIterator, Key>(dst, s_begin, s_end);
-      s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
+    h = radix_hash::radix_bits(radix_hash::item_key(dst[idx_i]));
+    idx_c = static_cast<int>((h & mask) >> shift);
+    if (idx_c == iter) {
+      counters[iter]++;
       continue;
     }
-    // Setup counters for counting sort.
-    for (int i = 0; i < partitions; i++)
-      counters[i] = 0;
-    indexes[0][0] = s_begin;
-    for (std::size_t i = s_begin; i < s_end; i++) {
-      h = std::get<0>(dst[i]);
-      counters[(h & mask) >> shift]++;
-    }
-    for (int i = 0; i < partitions - 1; i++) {
-      indexes[i][1] = indexes[i+1][0] = indexes[i][0] + counters[i];
-    }
-    indexes[partitions-1][1] = indexes[partitions-1][0]
-      + counters[partitions-1];
-
-    new_mask_bits = mask_bits - partition_bits;
-    iter = 0;
-
-    while (iter < partitions) {
-      idx_i = indexes[iter][0];
-      if (idx_i >= indexes[iter][1]) {
-        iter++;
-        continue;
-      }
-      h = std::get<0>(dst[idx_i]);
+    tmp_bucket = std::move(dst[idx_i]);
+    do {
+      h = radix_hash::radix_bits(radix_hash::item_key(tmp_bucket));
       idx_c = static_cast<int>((h & mask) >> shift);
-      if (idx_c == iter) {
-        indexes[iter][0]++;
-        continue;
-      }
-      tmp_bucket = std::move(dst[idx_i]);
-      do {
-        h = std::get<0>(tmp_bucket);
-        idx_c = (h & mask) >> shift;
-        idx_j = indexes[idx_c][0]++;
-        std::swap(dst[idx_j], tmp_bucket);
-      } while (idx_j > idx_i);
-    }
-
-    if (new_mask_bits <= 0) {
-      s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
-      continue;
-    }
+      idx_j = counters[idx_c]++;
+      std::swap(dst[idx_j], tmp_bucket);
+    } while (idx_j > idx_i);
+  }
 
-    // Reset indexes
-    indexes[0][0] = s_begin;
-    for (int i = 1; i < partitions; i++) {
-      indexes[i][0] = indexes[i-1][1];
-    }
-    rs1_helper_s<Key,Value,RandomAccessIterator>
-      (dst, indexes, new_mask_bits, partition_bits);
-    s_idx = super_counter->fetch_add(1, std::memory_order_relaxed);
+  // Bits below the digit are constant, every bucket is sorted.
+  new_mask_bits = mask_bits - partition_bits;
+  if (new_mask_bits <= 0 ||
+      (varying & rs1_low_mask<Bits>(new_mask_bits)) == 0) {
+    return 0;
   }
+  return new_mask_bits;
 }
 
-template<typename Key,
+// Same task scheduling as radix_hash::bf6_helper_p.
+template <typename Key,
   typename Value,
   typename RandomAccessIterator>
-  void rs1_worker(RandomAccessIterator dst,
-                  std::size_t begin,
-                  std::size_t end,
-                  int thread_id,
-                  ThreadBarrier* barrier,
-                  std::vector<std::mutex>* locks,
-                  std::vector<std::atomic_ullong>* shared_counters,
-                  std::vector<std::pair<std::size_t, std::size_t>>* sort_indexes,
-                  std::vector<std::pair<std::size_t, std::size_t>>* indexes,
-                  int partitions,
-                  int shift) {
-  Key h;
-  std::size_t local_counters[partitions];
-  std::size_t idx_i, idx_j;
-  std::pair<Key, Value> tmp_bucket;
-  int iter, idx_c;
-
-  for (int i = 0; i < partitions; i++)
-    local_counters[i] = 0;
+  void rs1_helper_p(RandomAccessIterator dst,
+                    int partition_bits,
+                    SortTaskQueues* queues,
+                    int thread_id) {
+  std::size_t insertion_limit =
+    radix_hash::insertion_threshold(partition_bits);
+  MsdScratch scratch(queues->mask_bits(), partition_bits);
+  SortTask task;
 
-  for (std::size_t i = begin; i < end; ++i) {
-    h = std::get<0>(dst[i]);
-    local_counters[h >> shift]++;
-  }
-  for (int i = 0; i < partitions; i++) {
-    (*shared_counters)[i].fetch_add(local_counters[i],
-                                    std::memory_order_relaxed);
+  while (queues->next(thread_id, &task)) {
+    msd_sort(task.begin, task.end, task.mask_bits, false, &scratch, queues,
+             thread_id,
+             [&](std::size_t s_begin, std::size_t s_end, int mask_bits,
+                 bool*, std::size_t* ends) {
+               return rs1_split<Key>(dst, s_begin, s_end, mask_bits,
+                                     partition_bits, insertion_limit,
+                                     scratch.counters(), ends);
+             });
+    queues->finish();
   }
+}
+
+// Per thread OR/AND of the encoded keys, reduced once before the first
+// scatter so that it starts at the top bit that varies.
+template<typename Bits>
+struct KeyBitsState {
+  explicit KeyBitsState(int num_threads)
+    : ors(num_threads), ands(num_threads), shift(0), mask_bits(0) {}
+  std::vector<Bits> ors;
+  std::vector<Bits> ands;
+  // Shift of the first digit and the bits left below it.
+  int shift;
+  int mask_bits;
+};
+
+template<typename Bits, typename Iterator>
+void rs1_key_bits_worker(Iterator t_begin,
+                         Iterator t_end,
+                         int thread_id,
+                         int thread_num,
+                         ThreadBarrier* barrier,
+                         KeyBitsState<Bits>* state,
+                         SortTaskQueues* queues,
+                         int partition_bits) {
+  Bits ors = 0, ands = static_cast<Bits>(~Bits(0));
+  int bits;
+
+  rs1_key_bits<Bits>(t_begin, t_end,
+                     &state->ors[thread_id], &state->ands[thread_id]);
 
   // in barrier
   if (barrier->wait()) {
-    local_counters[0] = 0;
-    (*indexes)[0].first = 0;
-    for (int i = 0; i < partitions - 1; i++) {
-      (*indexes)[i].second =
-       (*sort_indexes)[i+1].first =
-       (*sort_indexes)[i+1].second = 
-       (*indexes)[i+1].first = (*indexes)[i].first +
-       (*shared_counters)[i].load(std::memory_order_relaxed);
+    for (int i = 0; i < thread_num; i++) {
+      ors |= state->ors[i];
+      ands &= state->ands[i];
     }
-    (*indexes)[partitions-1].second = (*indexes)[partitions-1].first
-      + (*shared_counters)[partitions-1].load(std::memory_order_relaxed);
+    bits = rs1_bit_length<Bits>(ors ^ ands);
+    state->shift = bits < partition_bits ? 0 : bits - partition_bits;
+    state->mask_bits = bits - partition_bits;
+    queues->set_mask_bits(state->mask_bits);
     barrier->wait();
   } else {
     barrier->wait();
   }
-
-  iter = (thread_id * 17) % partitions;
-  while (iter < partitions) {
-    (*locks)[iter].lock();
-   retry_no_lock:
-    if ((*sort_indexes)[iter].first >= (*indexes)[iter].second) {
-      (*locks)[iter].unlock();
-      iter++;
-      continue;
-    }
-    idx_i = (*sort_indexes)[iter].first++;
-
-    h = std::get<0>(dst[idx_i]);
-    idx_c = static_cast<int>(h >> shift);
-    if (idx_c == iter) {
-      idx_j = (*sort_indexes)[iter].second++;
-      if (idx_i != idx_j) {
-        std::swap(dst[idx_i], dst[idx_j]);
-      }
-      goto retry_no_lock;
-    }
-    tmp_bucket = std::move(dst[idx_i]);
-    (*locks)[iter].unlock();
-    while (true) {
-      h = std::get<0>(tmp_bucket);
-      idx_c = static_cast<int>(h >> shift);
-      (*locks)[idx_c].lock();
-      if ((*sort_indexes)[idx_c].first > (*sort_indexes)[idx_c].second) {
-        // We have a blank spot to fill tmp_bucket in
-        idx_j = (*sort_indexes)[idx_c].second++;
-        dst[idx_j] = std::move(tmp_bucket);
-        (*locks)[idx_c].unlock();
-        break;
-      }
-      idx_j = (*sort_indexes)[idx_c].first;
-      (*sort_indexes)[idx_c].first++;
-      (*sort_indexes)[idx_c].second++;
-      std::swap(tmp_bucket, dst[idx_j]);
-      (*locks)[idx_c].unlock();
-    }
-  }
 }
 
-// radix_sort_1 use insertion sort when input is smaller than sqrt(p)
+// radix_sort_1 use insertion sort when input is smaller than
+// insertion_threshold(), sqrt(p) unless a tuning profile says otherwise
+//
+// Key may be any unsigned, signed or floating point arithmetic type; the
+// passes bucket radix_hash::radix_bits(key), which orders signed keys
+// numerically and floats by IEEE-754 total order (see radix_key.h).
+//
+// An OR/AND pass over the keys first finds the bits that vary, so the
+// first scatter starts at the highest of them rather than at the top of
+// Key. Each recursion level likewise skips digits that are constant in
+// its bucket and stops once the bits below the digit are constant.
 template <typename Key,
   typename Value,
   typename RandomAccessIterator>
   void radix_int_inplace(RandomAccessIterator dst,
                          std::size_t input_num,
+                         ThreadPool* pool,
                          int num_threads,
                          int partition_bits) {
-  static_assert(std::is_unsigned<Key>::value, "Key must be an unsigned arithmic type.");
-  int shift, partitions, thread_partition, new_mask_bits;
-  std::atomic_int a_counter(0);
+  static_assert(std::is_arithmetic<Key>::value, "Key must be an arithmetic type.");
+  typedef typename radix_hash::RadixKey<Key>::Bits Bits;
+  int partitions, thread_partition;
   ThreadBarrier barrier(num_threads);
 
   partitions = 1 << partition_bits;
   thread_partition = input_num / num_threads;
 
-  shift = sizeof(Key)*8 - partition_bits;
+  KeyBitsState<Bits> key_bits(num_threads);
+  radix_hash::ParadisState state(partitions, num_threads);
+  SortTaskQueues queues(num_threads, &state.indexes, 0);
 
-  std::vector<std::atomic_ullong> shared_counters(partitions);
-  std::vector<std::mutex> locks(partitions);
-  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
-  std::vector<std::pair<std::size_t, std::size_t>> sort_indexes(partitions);
-  std::vector<std::thread> threads(num_threads);
-
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(rs1_worker<Key,Value,
-                             RandomAccessIterator>,
-                             dst, i * thread_partition,
-                             (i+1) * thread_partition,
-                             i, &barrier, &locks, &shared_counters,
-                             &sort_indexes, &indexes,
-                             partitions, shift);
-  }
-
-  rs1_worker<Key,Value>(dst, (num_threads-1)*thread_partition,
-                        input_num, num_threads-1, &barrier, &locks,
-                        &shared_counters, &sort_indexes, &indexes,
-                        partitions, shift);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_begin = thread_id * thread_partition;
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : (thread_id + 1) * thread_partition;
+      rs1_key_bits_worker<Bits>(dst + t_begin, dst + t_end, thread_id,
+                                num_threads, &barrier, &key_bits, &queues,
+                                partition_bits);
+      radix_hash::radix_paradis_worker(dst, t_begin, t_end,
+                                       thread_id, num_threads, &barrier,
+                                       &state, partitions, key_bits.shift);
+      if (key_bits.mask_bits > 0) {
+        rs1_helper_p<Key,Value, RandomAccessIterator>(
+            dst, partition_bits, &queues, thread_id);
+      }
+    });
+}
 
-  new_mask_bits = sizeof(Key)*8 - partition_bits;
+template <typename Key,
+  typename Value,
+  typename RandomAccessIterator>
+  void radix_int_inplace(RandomAccessIterator dst,
+                         std::size_t input_num,
+                         int num_threads,
+                         int partition_bits) {
+  radix_int_inplace<Key,Value,RandomAccessIterator>
+   (dst, input_num, nullptr,
+    radix_hash::tuned_threads(num_threads, input_num), partition_bits);
+}
 
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(rs1_helper_p<Key,Value, RandomAccessIterator>,
-                             dst, indexes, new_mask_bits,
-                             partition_bits, &a_counter);
-  }
-  rs1_helper_p<Key,Value, RandomAccessIterator>(
-      dst, indexes, new_mask_bits,
-      partition_bits, &a_counter);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+template <typename Key,
+  typename Value,
+  typename RandomAccessIterator>
+  void radix_int_inplace(RandomAccessIterator dst,
+                         std::size_t input_num,
+                         ThreadPool& pool,
+                         int partition_bits) {
+  radix_int_inplace<Key,Value,RandomAccessIterator>
+   (dst, input_num, &pool, pool.size(), partition_bits);
 }
 
 template <typename Key,
@@ -397,6 +369,59 @@ template <typename Key,
    (dst, input_num, num_threads, partition_bits);
 }
 
+template <typename Key,
+  typename Value,
+  typename RandomAccessIterator>
+  void radix_int_inplace(RandomAccessIterator dst,
+                         unsigned int input_num,
+                         ThreadPool& pool) {
+  int partition_bits = radix_hash::optimal_partition(input_num);
+  radix_int_inplace<Key,Value,RandomAccessIterator>
+   (dst, input_num, pool, partition_bits);
+}
+
+template<typename Key,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void rs1_scatter_streaming(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             std::size_t* counters,
+                             int partitions,
+                             int shift,
+                             std::true_type) {
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type
+    KeyValue;
+  int idx_c;
+  radix_hash::StreamingScatter<KeyValue> buffer(&*dst, partitions);
+
+  for (auto iter = begin; iter != end; ++iter) {
+    idx_c = radix_hash::radix_digit(*iter, shift, partitions - 1);
+    buffer.push(idx_c, counters[idx_c]++,
+                KeyValue(*iter));
+  }
+  buffer.flush();
+}
+
+// Items that cannot be copied as raw bytes are scattered directly.
+template<typename Key,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void rs1_scatter_streaming(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             std::size_t* counters,
+                             int partitions,
+                             int shift,
+                             std::false_type) {
+  std::size_t dst_idx;
+  for (auto iter = begin; iter != end; ++iter) {
+    dst_idx = counters[radix_hash::radix_digit(*iter, shift,
+                                               partitions - 1)]++;
+    dst[dst_idx] = *iter;
+  }
+}
+
 template<typename Key,
   typename Value,
   typename BidirectionalIterator,
@@ -408,44 +433,41 @@ template<typename Key,
                             int thread_num,
                             ThreadBarrier* barrier,
                             std::vector<std::size_t>* shared_counters,
+                            std::vector<std::size_t>* block_sums,
                             std::vector<std::pair<std::size_t, std::size_t>>* indexes,
                             int partitions,
-                            int shift) {
-  Key h;
-  std::size_t dst_idx, tmp_cnt;
+                            int shift,
+                            radix_hash::ScatterMode mode) {
+  std::size_t dst_idx;
+  std::size_t* row = &(*shared_counters)[thread_id*partitions];
+  radix_hash::LocalCounters counters(partitions);
+  int idx_c;
 
   // TODO maybe we can make no sort version in worker as well.
-  for (auto iter = begin; iter != end; ++iter) {
-    h = iter->first;
-    (*shared_counters)[thread_id*partitions + (h>>shift)]++;
-  }
+  radix_hash::count_digits(begin, end, shift, partitions - 1,
+                           counters.data());
 
-  // in barrier
-  if (barrier->wait()) {
-    tmp_cnt = 0;
-    for (int i = 0; i < partitions; i++) {
-      for (int j = 0; j < thread_num; j++) {
-        tmp_cnt += (*shared_counters)[j*partitions + i];
-        (*shared_counters)[j*partitions + i] =
-          tmp_cnt - (*shared_counters)[j*partitions + i];
-      }
-    }
-    (*indexes)[0].first = 0;
-    for (int i = 1; i < partitions; i++) {
-      (*indexes)[i-1].second = (*indexes)[i].first = (*shared_counters)[i];
-    }
-    (*indexes)[partitions-1].second = tmp_cnt;
+  counters.publish(row);
+  radix_hash::prefix_sum_par(shared_counters->data(), partitions, thread_id,
+                             thread_num, barrier, block_sums->data(), indexes);
+  counters.fetch(row);
 
-    barrier->wait();
-  } else {
-    barrier->wait();
+  if (mode == radix_hash::kScatterStreaming) {
+    rs1_scatter_streaming<Key>(begin, end, dst, counters.data(),
+                               partitions, shift,
+                               std::integral_constant<bool,
+                               radix_hash::ContiguousStorage<
+                               RandomAccessIterator>::value &&
+                               std::is_trivially_copyable<Key>::value &&
+                               (std::is_void<Value>::value ||
+                                std::is_trivially_copyable<Value>::value)>());
+    return;
   }
 
   for (auto iter = begin; iter != end; ++iter) {
-    h = iter->first;
-    dst_idx = (*shared_counters)[thread_id*partitions + (h>>shift)]++;
-    std::get<0>(dst[dst_idx]) = h;
-    std::get<1>(dst[dst_idx]) = iter->second;
+    idx_c = radix_hash::radix_digit(*iter, shift, partitions - 1);
+    dst_idx = counters[idx_c]++;
+    dst[dst_idx] = *iter;
   }
 }
 
@@ -456,54 +478,71 @@ template <typename Key,
   void radix_int_non_inplace(BidirectionalIterator begin,
                              BidirectionalIterator end,
                              RandomAccessIterator dst,
+                             ThreadPool* pool,
                              int num_threads,
-                             int partition_bits) {
-  static_assert(std::is_unsigned<Key>::value, "Key must be an unsigned arithmic type.");
-  int input_num, shift, partitions, thread_partition, new_mask_bits;
-  std::atomic_int a_counter(0);
+                             int partition_bits,
+                             radix_hash::ScatterMode mode = radix_hash::kScatterDirect) {
+  static_assert(std::is_arithmetic<Key>::value, "Key must be an arithmetic type.");
+  typedef typename radix_hash::RadixKey<Key>::Bits Bits;
+  int input_num, partitions, thread_partition;
   ThreadBarrier barrier(num_threads);
 
   partitions = 1 << partition_bits;
   input_num = std::distance(begin, end);
   thread_partition = input_num / num_threads;
 
-  shift = sizeof(Key)*8 - partition_bits;
-
+  KeyBitsState<Bits> key_bits(num_threads);
   std::vector<std::size_t> shared_counters(partitions*num_threads);
+  std::vector<std::size_t> block_sums(num_threads);
   std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
-  std::vector<std::thread> threads(num_threads);
+  SortTaskQueues queues(num_threads, &indexes, 0);
 
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread
-     (radix_sort_ni_worker<Key, Value, BidirectionalIterator, RandomAccessIterator>,
-      begin + i * thread_partition,
-      begin + (i+1)*thread_partition,
-      dst, i, num_threads,
-      &barrier, &shared_counters, &indexes, partitions, shift);
-  }
-
-  radix_sort_ni_worker<Key, Value, BidirectionalIterator, RandomAccessIterator>
-   (begin + (num_threads-1)*thread_partition, end,
-    dst, num_threads-1, num_threads,
-    &barrier, &shared_counters, &indexes, partitions, shift);
-
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      BidirectionalIterator t_begin = begin + thread_id * thread_partition;
+      BidirectionalIterator t_end = thread_id == num_threads - 1 ?
+        end : begin + (thread_id + 1) * thread_partition;
+      rs1_key_bits_worker<Bits>(t_begin, t_end, thread_id, num_threads,
+                                &barrier, &key_bits, &queues, partition_bits);
+      radix_sort_ni_worker<Key, Value, BidirectionalIterator, RandomAccessIterator>
+       (t_begin, t_end, dst, thread_id, num_threads, &barrier,
+        &shared_counters, &block_sums, &indexes, partitions, key_bits.shift,
+        mode);
+      barrier.wait();
+      if (key_bits.mask_bits > 0) {
+        rs1_helper_p<Key,Value, RandomAccessIterator>(
+            dst, partition_bits, &queues, thread_id);
+      }
+    });
+}
 
-  new_mask_bits = sizeof(Key)*8 - partition_bits;
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_non_inplace(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             int num_threads,
+                             int partition_bits,
+                             radix_hash::ScatterMode mode = radix_hash::kScatterDirect) {
+  radix_int_non_inplace<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, nullptr,
+    radix_hash::tuned_threads(num_threads, std::distance(begin, end)),
+    partition_bits, mode);
+}
 
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i] = std::thread(rs1_helper_p<Key,Value, RandomAccessIterator>,
-                             dst, indexes, new_mask_bits,
-                             partition_bits, &a_counter);
-  }
-  rs1_helper_p<Key,Value, RandomAccessIterator>(
-      dst, indexes, new_mask_bits,
-      partition_bits, &a_counter);
-  for (int i = 0; i < num_threads-1; i++) {
-    threads[i].join();
-  }
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_non_inplace(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             ThreadPool& pool,
+                             int partition_bits,
+                             radix_hash::ScatterMode mode = radix_hash::kScatterDirect) {
+  radix_int_non_inplace<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, &pool, pool.size(), partition_bits, mode);
 }
 
 template <typename Key,
@@ -521,4 +560,706 @@ template <typename Key,
    (begin, end, dst, num_threads, partition_bits);
 }
 
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_non_inplace(BidirectionalIterator begin,
+                             BidirectionalIterator end,
+                             RandomAccessIterator dst,
+                             ThreadPool& pool) {
+  int input_num, partition_bits;
+  input_num = std::distance(begin, end);
+  partition_bits = radix_hash::optimal_partition(input_num);
+  radix_int_non_inplace<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, pool, partition_bits);
+}
+
+// Moves src[s_begin, s_end) to the same positions of dst.
+template<typename SrcIterator, typename DstIterator>
+static inline void rs1_move_range(SrcIterator src,
+                                  DstIterator dst,
+                                  std::size_t s_begin,
+                                  std::size_t s_end) {
+  for (std::size_t i = s_begin; i < s_end; i++) {
+    dst[i] = std::move(src[i]);
+  }
+}
+
+// Stable counting sort of src[s_begin, s_end) into the same range of dst
+// on the digit (h & mask) >> shift. offsets holds the first index of
+// every bucket and ends up holding their ends.
+template<typename Bits, typename SrcIterator, typename DstIterator>
+static inline void rs1_stable_scatter(SrcIterator src,
+                                      DstIterator dst,
+                                      std::size_t s_begin,
+                                      std::size_t s_end,
+                                      std::size_t* offsets,
+                                      Bits mask,
+                                      int shift) {
+  Bits h;
+  for (std::size_t i = s_begin; i < s_end; i++) {
+    h = radix_hash::radix_bits(radix_hash::item_key(src[i]));
+    dst[offsets[(h & mask) >> shift]++] = std::move(src[i]);
+  }
+}
+
+// One level of the stable MSD sort of a bucket on its low mask_bits bits.
+// The bucket is in scratch when *in_scratch is set, otherwise in dst.
+// Every level counting sorts it into the other array, flipping
+// *in_scratch, which keeps equal keys in order. Ranges that need no
+// further split are moved back to dst and 0 returned, so sorted items
+// always end up in dst; otherwise the bucket ends go to ends and the bits
+// left below the digit are returned.
+template <typename Key,
+  typename RandomAccessIterator,
+  typename ScratchIterator>
+  int rs1_stable_split(RandomAccessIterator dst,
+                       ScratchIterator scratch,
+                       std::size_t s_begin,
+                       std::size_t s_end,
+                       int mask_bits,
+                       bool* in_scratch,
+                       int partition_bits,
+                       std::size_t insertion_limit,
+                       std::size_t* counters,
+                       std::size_t* ends) {
+  typedef typename radix_hash::RadixKey<Key>::Bits Bits;
+  Bits mask, varying;
+  int partitions, shift, new_mask_bits;
+  std::size_t b_begin;
+
+  partitions = 1 << partition_bits;
+
+  // Insertion sort only swaps on strict <, so it is stable.
+  if (s_end - s_begin < 2 || s_end - s_begin < insertion_limit) {
+    if (*in_scratch)
+      rs1_move_range(scratch, dst, s_begin, s_end);
+    rs1_insertion_outer<RandomAccessIterator, Key>(dst, s_begin, s_end);
+    return 0;
+  }
+
+  if (*in_scratch)
+    varying = rs1_count_varying<Bits>(scratch, s_begin, s_end, &mask_bits,
+                                      partition_bits, counters);
+  else
+    varying = rs1_count_varying<Bits>(dst, s_begin, s_end, &mask_bits,
+                                      partition_bits, counters);
+  if (varying == 0) {
+    if (*in_scratch)
+      rs1_move_range(scratch, dst, s_begin, s_end);
+    return 0;
+  }
+  mask = rs1_low_mask<Bits>(mask_bits);
+  shift = mask_bits < partition_bits ? 0 : mask_bits - partition_bits;
+  // ends holds the running offsets of the scatter, which finish at the
+  // bucket ends.
+  b_begin = s_begin;
+  for (int i = 0; i < partitions; i++) {
+    ends[i] = b_begin;
+    b_begin += counters[i];
+  }
+  if (*in_scratch)
+    rs1_stable_scatter(scratch, dst, s_begin, s_end, ends, mask, shift);
+  else
+    rs1_stable_scatter(dst, scratch, s_begin, s_end, ends, mask, shift);
+  *in_scratch = !*in_scratch;
+
+  new_mask_bits = mask_bits - partition_bits;
+  if (new_mask_bits <= 0 ||
+      (varying & rs1_low_mask<Bits>(new_mask_bits)) == 0) {
+    if (*in_scratch)
+      rs1_move_range(scratch, dst, s_begin, s_end);
+    return 0;
+  }
+  return new_mask_bits;
+}
+
+template <typename Key,
+  typename RandomAccessIterator,
+  typename ScratchIterator>
+  void rs1_stable_p(RandomAccessIterator dst,
+                    ScratchIterator scratch,
+                    int partition_bits,
+                    SortTaskQueues* queues,
+                    int thread_id) {
+  std::size_t insertion_limit =
+    radix_hash::insertion_threshold(partition_bits);
+  MsdScratch msd_scratch(queues->mask_bits(), partition_bits);
+  SortTask task;
+
+  while (queues->next(thread_id, &task)) {
+    msd_sort(task.begin, task.end, task.mask_bits, task.in_scratch,
+             &msd_scratch, queues, thread_id,
+             [&](std::size_t s_begin, std::size_t s_end, int mask_bits,
+                 bool* in_scratch, std::size_t* ends) {
+               return rs1_stable_split<Key>(dst, scratch, s_begin, s_end,
+                                            mask_bits, in_scratch,
+                                            partition_bits, insertion_limit,
+                                            msd_scratch.counters(), ends);
+             });
+    queues->finish();
+  }
+}
+
+// Stable variant of radix_int_non_inplace: equal keys keep their input
+// order for any thread count. The top level scatter is the same per
+// thread prefix counted pass, which is stable already; the recursion then
+// counting sorts every bucket back and forth between dst and a scratch
+// array of input_num items instead of permuting it in place.
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_stable(BidirectionalIterator begin,
+                        BidirectionalIterator end,
+                        RandomAccessIterator dst,
+                        ThreadPool* pool,
+                        int num_threads,
+                        int partition_bits) {
+  static_assert(std::is_arithmetic<Key>::value, "Key must be an arithmetic type.");
+  typedef typename radix_hash::RadixKey<Key>::Bits Bits;
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type Item;
+  int input_num, partitions, thread_partition;
+  ThreadBarrier barrier(num_threads);
+
+  partitions = 1 << partition_bits;
+  input_num = std::distance(begin, end);
+  thread_partition = input_num / num_threads;
+
+  KeyBitsState<Bits> key_bits(num_threads);
+  std::vector<std::size_t> shared_counters(partitions*num_threads);
+  std::vector<std::size_t> block_sums(num_threads);
+  std::vector<std::pair<std::size_t, std::size_t>> indexes(partitions);
+  std::vector<Item> scratch(input_num);
+  SortTaskQueues queues(num_threads, &indexes, 0);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      BidirectionalIterator t_begin = begin + thread_id * thread_partition;
+      BidirectionalIterator t_end = thread_id == num_threads - 1 ?
+        end : begin + (thread_id + 1) * thread_partition;
+      rs1_key_bits_worker<Bits>(t_begin, t_end, thread_id, num_threads,
+                                &barrier, &key_bits, &queues, partition_bits);
+      radix_sort_ni_worker<Key, Value, BidirectionalIterator, RandomAccessIterator>
+       (t_begin, t_end, dst, thread_id, num_threads, &barrier,
+        &shared_counters, &block_sums, &indexes, partitions, key_bits.shift,
+        radix_hash::kScatterDirect);
+      barrier.wait();
+      if (key_bits.mask_bits > 0) {
+        rs1_stable_p<Key>(dst, scratch.begin(), partition_bits, &queues,
+                          thread_id);
+      }
+    });
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_stable(BidirectionalIterator begin,
+                        BidirectionalIterator end,
+                        RandomAccessIterator dst,
+                        int num_threads,
+                        int partition_bits) {
+  radix_int_stable<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, nullptr,
+    radix_hash::tuned_threads(num_threads, std::distance(begin, end)),
+    partition_bits);
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_stable(BidirectionalIterator begin,
+                        BidirectionalIterator end,
+                        RandomAccessIterator dst,
+                        ThreadPool& pool,
+                        int partition_bits) {
+  radix_int_stable<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, &pool, pool.size(), partition_bits);
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_stable(BidirectionalIterator begin,
+                        BidirectionalIterator end,
+                        RandomAccessIterator dst,
+                        int num_threads) {
+  int partition_bits;
+  partition_bits = radix_hash::optimal_partition(std::distance(begin, end));
+  radix_int_stable<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, num_threads, partition_bits);
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_stable(BidirectionalIterator begin,
+                        BidirectionalIterator end,
+                        RandomAccessIterator dst,
+                        ThreadPool& pool) {
+  int partition_bits;
+  partition_bits = radix_hash::optimal_partition(std::distance(begin, end));
+  radix_int_stable<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, pool, partition_bits);
+}
+
+// Stable scatter of src[t_begin, t_end) on one digit. offsets holds the
+// thread's first output index of every bucket.
+template <typename Bits,
+  typename SrcIterator,
+  typename DstIterator>
+  void lsd_scatter(SrcIterator src,
+                   DstIterator out,
+                   std::size_t t_begin,
+                   std::size_t t_end,
+                   std::size_t* offsets,
+                   int shift,
+                   Bits mask) {
+  Bits h;
+  std::size_t dst_idx;
+  for (std::size_t i = t_begin; i < t_end; i++) {
+    h = radix_hash::radix_bits(radix_hash::item_key(*(src + i)));
+    dst_idx = offsets[(h >> shift) & mask]++;
+    out[dst_idx] = *(src + i);
+  }
+}
+
+template <typename Bits,
+  typename SrcIterator>
+  void lsd_count(SrcIterator src,
+                 std::size_t t_begin,
+                 std::size_t t_end,
+                 std::size_t* counters,
+                 int shift,
+                 Bits mask) {
+  radix_hash::count_digits(src + t_begin, src + t_end, shift, mask,
+                           counters);
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator,
+  typename BufferIterator>
+  void radix_lsd_worker(BidirectionalIterator begin,
+                        RandomAccessIterator dst,
+                        BufferIterator buffer,
+                        std::size_t input_num,
+                        int thread_id,
+                        int thread_num,
+                        ThreadBarrier* barrier,
+                        std::vector<std::size_t>* digit_counters,
+                        std::vector<std::size_t>* offsets,
+                        std::vector<std::size_t>* block_sums,
+                        std::vector<int>* passes,
+                        int digit_bits) {
+  const int key_bits = sizeof(Key) * 8;
+  const int digits = (key_bits + digit_bits - 1) / digit_bits;
+  typedef typename radix_hash::RadixKey<Key>::Bits Bits;
+  const int buckets = 1 << digit_bits;
+  const Bits mask = static_cast<Bits>(buckets - 1);
+  std::size_t thread_partition, t_begin, t_end, tmp_cnt, max_cnt;
+  radix_hash::LocalCounters digit_local(digits * buckets);
+  radix_hash::LocalCounters local(buckets);
+  std::size_t* counters = local.data();
+  std::size_t* row;
+  int num_passes, digit;
+  bool to_dst;
+
+  thread_partition = input_num / thread_num;
+  t_begin = thread_id * thread_partition;
+  t_end = thread_id == thread_num - 1 ?
+    input_num : t_begin + thread_partition;
+
+  // Histograms of every digit in one read of the input.
+  for (std::size_t i = t_begin; i < t_end; i++) {
+    Bits h = radix_hash::radix_bits(radix_hash::item_key(*(begin + i)));
+    for (int d = 0; d < digits; d++) {
+      digit_local[d * buckets + ((h >> (d * digit_bits)) & mask)]++;
+    }
+  }
+  digit_local.publish(&(*digit_counters)[thread_id * digits * buckets]);
+
+  // in barrier
+  if (barrier->wait()) {
+    // Digits on which every key agrees do not move anything.
+    for (int d = 0; d < digits; d++) {
+      max_cnt = 0;
+      for (int i = 0; i < buckets; i++) {
+        tmp_cnt = 0;
+        for (int j = 0; j < thread_num; j++)
+          tmp_cnt += (*digit_counters)[(j * digits + d) * buckets + i];
+        max_cnt = std::max(max_cnt, tmp_cnt);
+      }
+      if (max_cnt != input_num)
+        passes->push_back(d);
+    }
+    barrier->wait();
+  } else {
+    barrier->wait();
+  }
+
+  num_passes = passes->size();
+  if (num_passes == 0) {
+    for (std::size_t i = t_begin; i < t_end; i++) {
+      dst[i] = *(begin + i);
+    }
+    return;
+  }
+
+  for (int p = 0; p < num_passes; p++) {
+    digit = (*passes)[p];
+    // Passes alternate between buffer and dst, ending in dst.
+    to_dst = (num_passes - p) % 2 == 1;
+    row = &(*offsets)[thread_id * buckets];
+    if (p == 0) {
+      std::copy(digit_local.data() + digit * buckets,
+                digit_local.data() + (digit + 1) * buckets, counters);
+    } else {
+      std::fill(counters, counters + buckets, 0);
+      if (to_dst)
+        lsd_count<Bits>(buffer, t_begin, t_end, counters,
+                        digit * digit_bits, mask);
+      else
+        lsd_count<Bits>(dst, t_begin, t_end, counters,
+                        digit * digit_bits, mask);
+    }
+
+    local.publish(row);
+    radix_hash::prefix_sum_par(offsets->data(), buckets, thread_id,
+                               thread_num, barrier, block_sums->data(),
+                               nullptr);
+    local.fetch(row);
+
+    if (p == 0 && to_dst)
+      lsd_scatter<Bits>(begin, dst, t_begin, t_end, counters,
+                        digit * digit_bits, mask);
+    else if (p == 0)
+      lsd_scatter<Bits>(begin, buffer, t_begin, t_end, counters,
+                        digit * digit_bits, mask);
+    else if (to_dst)
+      lsd_scatter<Bits>(buffer, dst, t_begin, t_end, counters,
+                        digit * digit_bits, mask);
+    else
+      lsd_scatter<Bits>(dst, buffer, t_begin, t_end, counters,
+                        digit * digit_bits, mask);
+    // The next pass counts what this one wrote.
+    barrier->wait();
+  }
+}
+
+// LSD variant of radix_int_non_inplace: a fixed number of digit_bits wide
+// passes ping-pong between dst and an internal buffer of the same size.
+// All digit histograms come from one upfront read of the input, which
+// also lets passes over digits that are constant across the input be
+// skipped. The sort is stable and its cost is a fixed number of passes
+// regardless of how keys are distributed, unlike the recursion of the MSD
+// engine. digit_bits of 8 or 11 keep the histograms in L1.
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_lsd(BidirectionalIterator begin,
+                     BidirectionalIterator end,
+                     RandomAccessIterator dst,
+                     ThreadPool* pool,
+                     int num_threads,
+                     int digit_bits) {
+  static_assert(std::is_arithmetic<Key>::value, "Key must be an arithmetic type.");
+  typedef typename std::iterator_traits<RandomAccessIterator>::value_type Item;
+  std::size_t input_num;
+  int digits, buckets;
+  ThreadBarrier barrier(num_threads);
+
+  input_num = std::distance(begin, end);
+  digits = (sizeof(Key) * 8 + digit_bits - 1) / digit_bits;
+  buckets = 1 << digit_bits;
+
+  std::vector<Item> buffer(input_num);
+  std::vector<std::size_t> digit_counters(num_threads * digits * buckets);
+  std::vector<std::size_t> offsets(num_threads * buckets);
+  std::vector<std::size_t> block_sums(num_threads);
+  std::vector<int> passes;
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      radix_lsd_worker<Key, Value>(begin, dst, buffer.begin(), input_num,
+                                   thread_id, num_threads, &barrier,
+                                   &digit_counters, &offsets, &block_sums,
+                                   &passes,
+                                   digit_bits);
+    });
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_lsd(BidirectionalIterator begin,
+                     BidirectionalIterator end,
+                     RandomAccessIterator dst,
+                     int num_threads,
+                     int digit_bits = 8) {
+  radix_int_lsd<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, nullptr,
+    radix_hash::tuned_threads(num_threads, std::distance(begin, end)),
+    digit_bits);
+}
+
+template <typename Key,
+  typename Value,
+  typename BidirectionalIterator,
+  typename RandomAccessIterator>
+  void radix_int_lsd(BidirectionalIterator begin,
+                     BidirectionalIterator end,
+                     RandomAccessIterator dst,
+                     ThreadPool& pool,
+                     int digit_bits = 8) {
+  radix_int_lsd<Key,Value,BidirectionalIterator,RandomAccessIterator>
+   (begin, end, dst, &pool, pool.size(), digit_bits);
+}
+
+// Random access view of keys[i] as the item (keys[i], i), so argsorts
+// feed the non-inplace sort without materializing their input.
+template<typename KeyIterator, typename Index>
+class IndexedKeyIterator {
+ public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef std::pair<typename std::iterator_traits<KeyIterator>::value_type,
+    Index> value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef value_type reference;
+  typedef const value_type* pointer;
+
+  IndexedKeyIterator(KeyIterator keys, std::size_t idx)
+    : _keys(keys), _idx(idx) {}
+  value_type operator*() const {
+    return value_type(_keys[_idx], static_cast<Index>(_idx));
+  }
+  IndexedKeyIterator& operator++() {
+    ++_idx;
+    return *this;
+  }
+  IndexedKeyIterator operator+(difference_type n) const {
+    return IndexedKeyIterator(_keys, _idx + n);
+  }
+  difference_type operator-(const IndexedKeyIterator& other) const {
+    return _idx - other._idx;
+  }
+  bool operator==(const IndexedKeyIterator& other) const {
+    return _idx == other._idx;
+  }
+  bool operator!=(const IndexedKeyIterator& other) const {
+    return _idx != other._idx;
+  }
+ private:
+  KeyIterator _keys;
+  std::size_t _idx;
+};
+
+// Writes to perm the permutation that sorts [begin, end), i.e.
+// begin[perm[0]] <= begin[perm[1]] <= ... Only (key, index) pairs move;
+// use a uint32_t Index when the input fits. Equal keys come out in no
+// particular order.
+template <typename Key,
+  typename Index,
+  typename KeyIterator,
+  typename IndexIterator>
+  void radix_int_argsort(KeyIterator begin,
+                         KeyIterator end,
+                         IndexIterator perm,
+                         ThreadPool* pool,
+                         int num_threads,
+                         int partition_bits) {
+  static_assert(std::is_unsigned<Index>::value, "Index must be an unsigned integer type.");
+  typedef IndexedKeyIterator<KeyIterator, Index> InputIterator;
+  std::size_t input_num, thread_partition;
+
+  input_num = std::distance(begin, end);
+  assert(input_num == 0 ||
+         input_num - 1 <= std::numeric_limits<Index>::max());
+  thread_partition = input_num / num_threads;
+
+  std::vector<std::pair<Key, Index>> sorted(input_num);
+  radix_int_non_inplace<Key, Index>
+    (InputIterator(begin, 0), InputIterator(begin, input_num),
+     sorted.begin(), pool, num_threads, partition_bits);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_begin = thread_id * thread_partition;
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : t_begin + thread_partition;
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        perm[i] = sorted[i].second;
+      }
+    });
+}
+
+template <typename Key,
+  typename Index,
+  typename KeyIterator,
+  typename IndexIterator>
+  void radix_int_argsort(KeyIterator begin,
+                         KeyIterator end,
+                         IndexIterator perm,
+                         int num_threads,
+                         int partition_bits) {
+  radix_int_argsort<Key,Index,KeyIterator,IndexIterator>
+   (begin, end, perm, nullptr,
+    radix_hash::tuned_threads(num_threads, std::distance(begin, end)),
+    partition_bits);
+}
+
+template <typename Key,
+  typename Index,
+  typename KeyIterator,
+  typename IndexIterator>
+  void radix_int_argsort(KeyIterator begin,
+                         KeyIterator end,
+                         IndexIterator perm,
+                         ThreadPool& pool,
+                         int partition_bits) {
+  radix_int_argsort<Key,Index,KeyIterator,IndexIterator>
+   (begin, end, perm, &pool, pool.size(), partition_bits);
+}
+
+template <typename Key,
+  typename Index,
+  typename KeyIterator,
+  typename IndexIterator>
+  void radix_int_argsort(KeyIterator begin,
+                         KeyIterator end,
+                         IndexIterator perm,
+                         int num_threads) {
+  int partition_bits;
+  partition_bits = radix_hash::optimal_partition(std::distance(begin, end));
+  radix_int_argsort<Key,Index,KeyIterator,IndexIterator>
+   (begin, end, perm, num_threads, partition_bits);
+}
+
+template <typename Key,
+  typename Index,
+  typename KeyIterator,
+  typename IndexIterator>
+  void radix_int_argsort(KeyIterator begin,
+                         KeyIterator end,
+                         IndexIterator perm,
+                         ThreadPool& pool) {
+  int partition_bits;
+  partition_bits = radix_hash::optimal_partition(std::distance(begin, end));
+  radix_int_argsort<Key,Index,KeyIterator,IndexIterator>
+   (begin, end, perm, pool, partition_bits);
+}
+
+// Applies the permutation in sorted to payload through a scratch copy.
+template <typename Key,
+  typename Index,
+  typename PayloadIterator>
+  void rs1_permute_array(const std::vector<std::pair<Key, Index>>& sorted,
+                         PayloadIterator payload,
+                         ThreadPool* pool,
+                         int num_threads) {
+  typedef typename std::iterator_traits<PayloadIterator>::value_type Item;
+  std::size_t input_num = sorted.size();
+  std::size_t thread_partition = input_num / num_threads;
+  std::vector<Item> scratch(input_num);
+  ThreadBarrier barrier(num_threads);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_begin = thread_id * thread_partition;
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : t_begin + thread_partition;
+      // Every item is read exactly once, so it can be moved out.
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        scratch[i] = std::move(payload[sorted[i].second]);
+      }
+      barrier.wait();
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        payload[i] = std::move(scratch[i]);
+      }
+    });
+}
+
+template <typename Key,
+  typename Index,
+  typename KeyIterator,
+  typename... PayloadIterators>
+  void rs1_sort_arrays(KeyIterator keys,
+                       std::size_t input_num,
+                       ThreadPool* pool,
+                       int num_threads,
+                       int partition_bits,
+                       PayloadIterators... payloads) {
+  std::size_t thread_partition = input_num / num_threads;
+  std::vector<std::pair<Key, Index>> sorted(input_num);
+
+  radix_int_non_inplace<Key, Index>
+    (IndexedKeyIterator<KeyIterator, Index>(keys, 0),
+     IndexedKeyIterator<KeyIterator, Index>(keys, input_num),
+     sorted.begin(), pool, num_threads, partition_bits);
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_begin = thread_id * thread_partition;
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : t_begin + thread_partition;
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        keys[i] = sorted[i].first;
+      }
+    });
+  int expand[] = {0, (rs1_permute_array(sorted, payloads, pool,
+                                        num_threads), 0)...};
+  (void)expand;
+}
+
+// Sorts keys[0, input_num) and reorders any number of parallel payload
+// arrays the same way, e.g. columns of a table sorted by one of them.
+// The sort itself moves only (key, row) pairs with a 32 bit row when
+// input_num allows; payloads are then permuted one after another, so the
+// extra memory is the pair buffer plus one copy of the largest payload.
+template <typename Key,
+  typename KeyIterator,
+  typename... PayloadIterators>
+  void radix_int_sort_arrays(KeyIterator keys,
+                             std::size_t input_num,
+                             ThreadPool* pool,
+                             int num_threads,
+                             int partition_bits,
+                             PayloadIterators... payloads) {
+  if (input_num <= std::numeric_limits<uint32_t>::max()) {
+    rs1_sort_arrays<Key, uint32_t>(keys, input_num, pool, num_threads,
+                                   partition_bits, payloads...);
+  } else {
+    rs1_sort_arrays<Key, uint64_t>(keys, input_num, pool, num_threads,
+                                   partition_bits, payloads...);
+  }
+}
+
+template <typename Key,
+  typename KeyIterator,
+  typename... PayloadIterators>
+  void radix_int_sort_arrays(KeyIterator keys,
+                             std::size_t input_num,
+                             int num_threads,
+                             PayloadIterators... payloads) {
+  radix_int_sort_arrays<Key>(keys, input_num, nullptr,
+                             radix_hash::tuned_threads(num_threads, input_num),
+                             radix_hash::optimal_partition(input_num),
+                             payloads...);
+}
+
+template <typename Key,
+  typename KeyIterator,
+  typename... PayloadIterators>
+  void radix_int_sort_arrays(KeyIterator keys,
+                             std::size_t input_num,
+                             ThreadPool& pool,
+                             PayloadIterators... payloads) {
+  radix_int_sort_arrays<Key>(keys, input_num, &pool, pool.size(),
+                             radix_hash::optimal_partition(input_num),
+                             payloads...);
+}
+
 #endif
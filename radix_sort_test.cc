@@ -17,7 +17,12 @@
 #include "radix_sort.h"
 #include "gtest/gtest.h"
 #include <vector>
+#include <deque>
 #include <random>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
 
 bool pair_cmp (std::pair<std::size_t, int> a,
                std::pair<std::size_t, int> b) {
@@ -45,6 +50,29 @@ TEST(radix_sort_1_test, random_num) {
   }
 }
 
+TEST(radix_sort_1_test, skewed_many_threads) {
+  // Few hot buckets force several permute and repair rounds.
+  int size = 1<<17;
+  std::vector<std::pair<std::size_t, int>> input;
+  std::vector<std::pair<std::size_t, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    if (i % 4)
+      r = (r & 3ULL) << 62 | (r & 1023);
+    input.push_back(std::make_pair(r, i));
+  }
+  std_sorted = input;
+  std::sort(std_sorted.begin(), std_sorted.end(), pair_cmp);
+
+  ::radix_int_inplace<std::size_t,int>(input.begin(), size, 8, 10);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(input[i]));
+  }
+}
+
 TEST(radix_sort_non_inplace_test, random_num) {
   int size = 1<<16;
   std::vector<std::pair<std::size_t, int>> src;
@@ -66,3 +94,452 @@ TEST(radix_sort_non_inplace_test, random_num) {
     EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
   }
 }
+
+TEST(radix_sort_1_test, thread_pool_reuse) {
+  int size = 1<<16;
+  std::vector<std::pair<std::size_t, int>> input;
+  std::vector<std::pair<std::size_t, int>> work;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  std::vector<std::pair<std::size_t, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  ThreadPool pool(4);
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    input.push_back(std::make_pair(r, i));
+  }
+  std_sorted = input;
+  std::sort(std_sorted.begin(), std_sorted.end(), pair_cmp);
+
+  for (int round = 0; round < 3; round++) {
+    work = input;
+    ::radix_int_inplace<std::size_t,int>(work.begin(), size, pool);
+    ::radix_int_non_inplace<std::size_t,int>(input.begin(), input.end(), dst.begin(), pool);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(work[i]));
+      EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
+    }
+  }
+}
+
+TEST(radix_sort_non_inplace_test, streaming_scatter) {
+  int size = 1<<18;
+  std::vector<std::pair<std::size_t, int>> src;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  std::vector<std::pair<std::size_t, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  unsigned int cores = std::thread::hardware_concurrency();
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    src.push_back(std::make_pair(r, i));
+  }
+  std_sorted = src;
+  std::sort(std_sorted.begin(), std_sorted.end(), pair_cmp);
+
+  ::radix_int_non_inplace<std::size_t,int>(src.begin(), src.end(), dst.begin(),
+                                           cores, 12, radix_hash::kScatterStreaming);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
+  }
+}
+
+TEST(radix_sort_non_inplace_test, streaming_scatter_deque) {
+  // A deque is not contiguous, streaming falls back to direct stores.
+  int size = 1<<16;
+  std::vector<std::pair<uint64_t, uint64_t>> src;
+  std::deque<std::pair<uint64_t, uint64_t>> dst(size);
+  std::vector<std::pair<uint64_t, uint64_t>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> distribution;
+
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(distribution(generator), i));
+  }
+  std_sorted = src;
+  std::sort(std_sorted.begin(), std_sorted.end());
+
+  ::radix_int_non_inplace<uint64_t,uint64_t>(src.begin(), src.end(),
+                                             dst.begin(), 2, 8,
+                                             radix_hash::kScatterStreaming);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
+  }
+}
+
+TEST(radix_sort_non_inplace_test, skewed_many_threads) {
+  int size = 1<<17;
+  std::vector<std::pair<std::size_t, int>> src;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  std::vector<std::pair<std::size_t, int>> std_sorted;
+  std::default_random_engine generator;
+  std::geometric_distribution<std::size_t> distribution(0.0001);
+
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(distribution(generator), i));
+  }
+  std_sorted = src;
+  std::sort(std_sorted.begin(), std_sorted.end(), pair_cmp);
+
+  ::radix_int_non_inplace<std::size_t,int>(src.begin(), src.end(), dst.begin(), 8, 8);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
+  }
+}
+
+TEST(radix_sort_1_test, narrow_key_range) {
+  // Keys that only vary in a few bits: small ids, a shared high prefix,
+  // constant low bits, a constant middle and all keys equal.
+  int size = 1<<17;
+  std::vector<std::pair<std::size_t, int>> input, work;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  std::vector<std::pair<std::size_t, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+
+  for (int shape = 0; shape < 5; shape++) {
+    input.clear();
+    for (int i = 0; i < size; i++) {
+      std::size_t r = distribution(generator);
+      switch (shape) {
+      case 0: r &= (1ULL << 20) - 1; break;
+      case 1: r = 0xABCDULL << 48 | (r & 0xFFFFFFFFULL); break;
+      case 2: r = (r & 0xFFFFF) << 24; break;
+      case 3: r = (r & 0xF) << 60 | (r >> 8 & 0xFFF); break;
+      default: r = 42; break;
+      }
+      input.push_back(std::make_pair(r, i));
+    }
+    std_sorted = input;
+    std::sort(std_sorted.begin(), std_sorted.end(), pair_cmp);
+
+    work = input;
+    ::radix_int_inplace<std::size_t,int>(work.begin(), size, 3, 8);
+    ::radix_int_non_inplace<std::size_t,int>(input.begin(), input.end(),
+                                             dst.begin(), 3, 8);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(work[i]));
+      EXPECT_EQ(std::get<0>(std_sorted[i]), std::get<0>(dst[i]));
+    }
+  }
+}
+
+TEST(radix_sort_lsd_test, random_num) {
+  int size = 100003;
+  std::vector<std::pair<std::size_t, int>> src;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  std::vector<std::pair<std::size_t, int>> std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(distribution(generator), i));
+  }
+  std_sorted = src;
+  std::sort(std_sorted.begin(), std_sorted.end(), pair_cmp);
+
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    for (int digit_bits = 8; digit_bits <= 11; digit_bits += 3) {
+      ::radix_int_lsd<std::size_t,int>(src.begin(), src.end(), dst.begin(),
+                                       threads, digit_bits);
+      for (int i = 0; i < size; i++) {
+        ASSERT_EQ(std_sorted[i], dst[i]);
+      }
+    }
+  }
+}
+
+TEST(radix_sort_lsd_test, stable_small_keys) {
+  // Only the low one or two digits vary, the other passes are skipped and
+  // both an odd and an even number of passes must end in dst.
+  int size = 50000;
+  ThreadPool pool(4);
+
+  for (uint32_t max_key = 200; max_key <= 1000; max_key += 800) {
+    std::vector<std::pair<uint32_t, int>> src;
+    std::vector<std::pair<uint32_t, int>> dst(size);
+    std::vector<std::pair<uint32_t, int>> std_sorted;
+    std::default_random_engine generator;
+    std::uniform_int_distribution<uint32_t> distribution(0, max_key);
+
+    for (int i = 0; i < size; i++) {
+      src.push_back(std::make_pair(distribution(generator), i));
+    }
+    std_sorted = src;
+    std::stable_sort(std_sorted.begin(), std_sorted.end(),
+                     [](const std::pair<uint32_t, int>& a,
+                        const std::pair<uint32_t, int>& b) {
+                       return a.first < b.first;
+                     });
+
+    ::radix_int_lsd<uint32_t,int>(src.begin(), src.end(), dst.begin(), pool);
+    for (int i = 0; i < size; i++) {
+      ASSERT_EQ(std_sorted[i], dst[i]);
+    }
+  }
+}
+
+TEST(radix_sort_lsd_test, equal_keys) {
+  int size = 1000;
+  std::vector<std::pair<std::size_t, int>> src;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(7, i));
+  }
+  ::radix_int_lsd<std::size_t,int>(src.begin(), src.end(), dst.begin(), 3);
+  EXPECT_EQ(src, dst);
+}
+
+TEST(radix_sort_key_test, signed_keys) {
+  int size = 1<<16;
+  std::vector<std::pair<int64_t, int>> src, work;
+  std::vector<std::pair<int64_t, int>> dst(size), lsd(size);
+  std::vector<std::pair<int32_t, int>> src32, dst32(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int64_t> distribution;
+
+  for (int i = 0; i < size; i++) {
+    int64_t r = distribution(generator) - (1LL << 62);
+    if (i % 3 == 0)
+      r %= 1000;
+    if (i < 2)
+      r = i ? std::numeric_limits<int64_t>::max()
+        : std::numeric_limits<int64_t>::min();
+    src.push_back(std::make_pair(r, i));
+    src32.push_back(std::make_pair(static_cast<int32_t>(r), i));
+  }
+  work = src;
+  ::radix_int_inplace<int64_t,int>(work.begin(), size, 3, 8);
+  ::radix_int_non_inplace<int64_t,int>(src.begin(), src.end(),
+                                       dst.begin(), 3, 8);
+  ::radix_int_lsd<int64_t,int>(src.begin(), src.end(), lsd.begin(), 3);
+  ::radix_int_non_inplace<int32_t,int>(src32.begin(), src32.end(),
+                                       dst32.begin(), 3, 8);
+  std::stable_sort(src.begin(), src.end(),
+                   [](const std::pair<int64_t, int>& a,
+                      const std::pair<int64_t, int>& b) {
+                     return a.first < b.first;
+                   });
+  std::sort(src32.begin(), src32.end());
+  EXPECT_EQ(src, lsd);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(src[i].first, work[i].first);
+    EXPECT_EQ(src[i].first, dst[i].first);
+    EXPECT_EQ(src32[i].first, dst32[i].first);
+  }
+}
+
+// IEEE-754 total order: -NaN, numbers with -0.0 before +0.0, +NaN.
+template<typename Float>
+static bool total_order_less(Float a, Float b) {
+  int rank_a = std::isnan(a) ? (std::signbit(a) ? 0 : 2) : 1;
+  int rank_b = std::isnan(b) ? (std::signbit(b) ? 0 : 2) : 1;
+  if (rank_a != rank_b || rank_a != 1)
+    return rank_a < rank_b;
+  if (a < b || b < a)
+    return a < b;
+  return std::signbit(a) && !std::signbit(b);
+}
+
+template<typename Float>
+static void expect_total_order(const std::vector<std::pair<Float, int>>& v,
+                               const std::vector<std::pair<Float, int>>& e) {
+  ASSERT_EQ(e.size(), v.size());
+  for (std::size_t i = 0; i < v.size(); i++) {
+    EXPECT_FALSE(total_order_less(v[i].first, e[i].first) ||
+                 total_order_less(e[i].first, v[i].first)) << i;
+  }
+}
+
+TEST(radix_sort_key_test, float_keys) {
+  int size = 1<<16;
+  std::vector<std::pair<double, int>> src, work;
+  std::vector<std::pair<double, int>> dst(size), lsd(size);
+  std::vector<std::pair<float, int>> src32, dst32(size);
+  const double specials[] = {
+    std::numeric_limits<double>::quiet_NaN(),
+    -std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::infinity(),
+    -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::denorm_min(),
+    -std::numeric_limits<double>::denorm_min(),
+    0.0, -0.0, 1.0, -1.0};
+  std::default_random_engine generator;
+  std::normal_distribution<double> distribution(0, 1e6);
+
+  for (int i = 0; i < size; i++) {
+    double r = i % 16 ? distribution(generator) : specials[(i / 16) % 10];
+    src.push_back(std::make_pair(r, i));
+    src32.push_back(std::make_pair(static_cast<float>(r), i));
+  }
+  work = src;
+  ::radix_int_inplace<double,int>(work.begin(), size, 3, 8);
+  ::radix_int_non_inplace<double,int>(src.begin(), src.end(),
+                                      dst.begin(), 3, 8);
+  ::radix_int_lsd<double,int>(src.begin(), src.end(), lsd.begin(), 3);
+  ::radix_int_non_inplace<float,int>(src32.begin(), src32.end(),
+                                     dst32.begin(), 3, 8);
+  std::stable_sort(src.begin(), src.end(),
+                   [](const std::pair<double, int>& a,
+                      const std::pair<double, int>& b) {
+                     return total_order_less(a.first, b.first);
+                   });
+  std::stable_sort(src32.begin(), src32.end(),
+                   [](const std::pair<float, int>& a,
+                      const std::pair<float, int>& b) {
+                     return total_order_less(a.first, b.first);
+                   });
+  expect_total_order(work, src);
+  expect_total_order(dst, src);
+  expect_total_order(lsd, src);
+  expect_total_order(dst32, src32);
+  // The LSD sort is stable.
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(src[i].second, lsd[i].second);
+  }
+}
+
+TEST(radix_sort_variant_test, key_only) {
+  int size = 1<<16;
+  std::vector<uint64_t> src, work;
+  std::vector<uint64_t> dst(size), lsd(size);
+  std::vector<int32_t> src32, dst32(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> distribution;
+
+  for (int i = 0; i < size; i++) {
+    uint64_t r = distribution(generator);
+    src.push_back(r);
+    src32.push_back(static_cast<int32_t>(r));
+  }
+  work = src;
+  ::radix_int_inplace<uint64_t,void>(work.begin(), size, 3, 8);
+  ::radix_int_non_inplace<uint64_t,void>(src.begin(), src.end(),
+                                         dst.begin(), 3, 8);
+  ::radix_int_lsd<uint64_t,void>(src.begin(), src.end(), lsd.begin(), 3);
+  ::radix_int_non_inplace<int32_t,void>(src32.begin(), src32.end(),
+                                        dst32.begin(), 3, 8);
+  std::sort(src.begin(), src.end());
+  std::sort(src32.begin(), src32.end());
+  EXPECT_EQ(src, work);
+  EXPECT_EQ(src, dst);
+  EXPECT_EQ(src, lsd);
+  EXPECT_EQ(src32, dst32);
+}
+
+TEST(radix_sort_variant_test, argsort) {
+  int size = 1<<16;
+  std::vector<int64_t> keys;
+  std::vector<uint32_t> perm(size);
+  std::vector<uint64_t> perm64(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int64_t> distribution(-1000000, 1000000);
+  ThreadPool pool(3);
+
+  for (int i = 0; i < size; i++) {
+    keys.push_back(distribution(generator));
+  }
+  ::radix_int_argsort<int64_t,uint32_t>(keys.begin(), keys.end(),
+                                        perm.begin(), 3);
+  ::radix_int_argsort<int64_t,uint64_t>(keys.begin(), keys.end(),
+                                        perm64.begin(), pool);
+  std::vector<bool> seen(size), seen64(size);
+  for (int i = 0; i < size; i++) {
+    seen[perm[i]] = true;
+    seen64[perm64[i]] = true;
+    if (i > 0) {
+      EXPECT_LE(keys[perm[i-1]], keys[perm[i]]);
+      EXPECT_LE(keys[perm64[i-1]], keys[perm64[i]]);
+    }
+  }
+  EXPECT_EQ(std::vector<bool>(size, true), seen);
+  EXPECT_EQ(std::vector<bool>(size, true), seen64);
+}
+
+TEST(radix_sort_variant_test, parallel_arrays) {
+  int size = 1<<16;
+  std::vector<uint64_t> keys, original;
+  std::vector<std::string> names;
+  std::vector<int> rows;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint64_t> distribution;
+  ThreadPool pool(2);
+
+  for (int round = 0; round < 2; round++) {
+    keys.clear();
+    names.clear();
+    rows.clear();
+    for (int i = 0; i < size; i++) {
+      keys.push_back(distribution(generator));
+      names.push_back(std::to_string(i));
+      rows.push_back(i);
+    }
+    original = keys;
+    if (round == 0)
+      ::radix_int_sort_arrays<uint64_t>(keys.begin(), size, 3,
+                                        names.begin(), rows.begin());
+    else
+      ::radix_int_sort_arrays<uint64_t>(keys.begin(), size, pool,
+                                        names.begin(), rows.begin());
+    for (int i = 0; i < size; i++) {
+      if (i > 0) {
+        EXPECT_LE(keys[i-1], keys[i]);
+      }
+      EXPECT_EQ(original[rows[i]], keys[i]);
+      EXPECT_EQ(std::to_string(rows[i]), names[i]);
+    }
+  }
+}
+
+TEST(radix_sort_stable_test, equal_keys_keep_order) {
+  // Many duplicates, plus one hot top level bucket whose sub-buckets are
+  // large enough to be scheduled as tasks while they sit in scratch.
+  int size = 1<<18;
+  std::vector<std::pair<std::size_t, int>> src, expected;
+  std::vector<std::pair<std::size_t, int>> dst(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  ThreadPool pool(4);
+
+  for (int i = 0; i < size; i++) {
+    std::size_t r = distribution(generator);
+    if (i % 7 == 0)
+      r %= 1000;
+    else if (i % 7 < 5)
+      r = 1ULL << 40 | (r & 3) << 30 | (r >> 8 & 0xFFFFF);
+    src.push_back(std::make_pair(r, i));
+  }
+  expected = src;
+  std::stable_sort(expected.begin(), expected.end(), pair_cmp);
+
+  for (int num_threads = 1; num_threads <= 3; num_threads++) {
+    ::radix_int_stable<std::size_t,int>(src.begin(), src.end(),
+                                        dst.begin(), num_threads, 8);
+    EXPECT_EQ(expected, dst);
+  }
+  ::radix_int_stable<std::size_t,int>(src.begin(), src.end(),
+                                      dst.begin(), pool);
+  EXPECT_EQ(expected, dst);
+}
+
+TEST(radix_sort_stable_test, small_key_range) {
+  int size = 1<<16;
+  std::vector<std::pair<int32_t, int>> src, expected;
+  std::vector<std::pair<int32_t, int>> dst(size);
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int32_t> distribution(-50, 50);
+
+  for (int i = 0; i < size; i++) {
+    src.push_back(std::make_pair(distribution(generator), i));
+  }
+  expected = src;
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const std::pair<int32_t, int>& a,
+                      const std::pair<int32_t, int>& b) {
+                     return a.first < b.first;
+                   });
+  ::radix_int_stable<int32_t,int>(src.begin(), src.end(), dst.begin(), 3);
+  EXPECT_EQ(expected, dst);
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Calibrates the radix sorts for this machine and writes a tuning profile.
+//
+//   radix_tune [profile path] [max input size]
+//
+// The path defaults to $FUNNELHASH_TUNING. Point FUNNELHASH_TUNING at the
+// written file to make every entry point pick it up. The max input size
+// defaults to 10M items and must be at least kMinInput, the smallest size
+// class. Partition bits and threads are picked by timing the sorts, which
+// takes the caches and the TLB into account without modelling them.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "radix_hash.h"
+#include "radix_sort.h"
+#include "tuning.h"
+
+using radix_hash::TuningProfile;
+
+static const int kRepeats = 3;
+// Smallest size class measured.
+static const std::size_t kMinInput = 10*1000;
+
+typedef std::vector<std::pair<std::size_t, uint64_t>> IntVec;
+
+// Best of kRepeats wall times of one radix_int_non_inplace call.
+static double time_sort(const IntVec& input, IntVec* work,
+                        ThreadPool* pool, int num_threads,
+                        int partition_bits) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < kRepeats; i++) {
+    auto start = std::chrono::steady_clock::now();
+    ::radix_int_non_inplace<std::size_t, uint64_t>
+      (input.begin(), input.end(), work->begin(), pool, num_threads,
+       partition_bits);
+    std::chrono::duration<double> spent =
+      std::chrono::steady_clock::now() - start;
+    if (spent.count() < best)
+      best = spent.count();
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  const char* env_path = getenv(radix_hash::kTuningEnv);
+  std::string path = argc > 1 ? argv[1] : (env_path ? env_path : "");
+  std::size_t max_input = 10*1000*1000;
+  unsigned int cores = std::thread::hardware_concurrency();
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  TuningProfile profile;
+  std::vector<int> thread_counts;
+  std::vector<std::size_t> sizes;
+
+  if (path.empty()) {
+    fprintf(stderr, "usage: %s <profile path> [max input size]\n"
+            "       or set %s\n", argv[0], radix_hash::kTuningEnv);
+    return 1;
+  }
+  if (argc > 2) {
+    char* end;
+    max_input = strtoull(argv[2], &end, 10);
+    if (*argv[2] == '\0' || *end != '\0' || max_input < kMinInput) {
+      fprintf(stderr, "max input size must be a number of at least %zu\n",
+              kMinInput);
+      return 1;
+    }
+  }
+  cores = cores ? cores : 1;
+  for (unsigned int t = 1; t < cores; t *= 2)
+    thread_counts.push_back(t);
+  thread_counts.push_back(cores);
+  for (std::size_t n = kMinInput; n <= max_input; n *= 10)
+    sizes.push_back(n);
+  printf("cores %u\n", cores);
+
+  // Calibrate against the built in defaults only.
+  radix_hash::set_tuning_profile(TuningProfile());
+
+  IntVec input, work;
+  for (std::size_t i = 0; i < sizes.size(); i++) {
+    std::size_t n = sizes[i];
+    input.resize(n);
+    work.resize(n);
+    for (std::size_t j = 0; j < n; j++)
+      input[j] = std::make_pair(distribution(generator), j);
+
+    TuningProfile::SizeClass best = {0, 0, 0};
+    double best_time = std::numeric_limits<double>::max();
+    for (int num_threads : thread_counts) {
+      ThreadPool pool(num_threads);
+      for (int k = 6; k < 15; k++) {
+        double t = time_sort(input, &work, &pool, num_threads, k);
+        if (t < best_time) {
+          best_time = t;
+          best.partition_bits = k;
+          best.num_threads = num_threads;
+        }
+      }
+    }
+    // A class covers inputs up to the geometric middle of the next size.
+    best.max_input = i + 1 < sizes.size() ?
+      static_cast<std::size_t>(n * 3.16) :
+      std::numeric_limits<std::size_t>::max();
+    profile.size_classes.push_back(best);
+    printf("%zu items: %d partition bits, %d threads, %.3f ms\n",
+           n, best.partition_bits, best.num_threads, best_time * 1000);
+  }
+
+  // The insertion cutoff is swept on the largest size with its settings.
+  {
+    const TuningProfile::SizeClass& last = profile.size_classes.back();
+    ThreadPool pool(last.num_threads);
+    double best_time = std::numeric_limits<double>::max();
+    for (std::size_t threshold = 4; threshold <= 256; threshold *= 2) {
+      TuningProfile trial;
+      trial.insertion_threshold = threshold;
+      radix_hash::set_tuning_profile(trial);
+      double t = time_sort(input, &work, &pool, last.num_threads,
+                           last.partition_bits);
+      if (t < best_time) {
+        best_time = t;
+        profile.insertion_threshold = threshold;
+      }
+    }
+    printf("insertion threshold %zu\n", profile.insertion_threshold);
+  }
+
+  if (!profile.save(path)) {
+    fprintf(stderr, "cannot write %s\n", path.c_str());
+    return 1;
+  }
+  printf("wrote %s\n", path.c_str());
+  return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCATTER_BUFFER_H
+#define SCATTER_BUFFER_H 1
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace radix_hash {
+
+enum ScatterMode {
+  // Store every item straight into its destination slot.
+  kScatterDirect,
+  // Stage items in per partition cache line buffers and flush whole lines
+  // with non-temporal stores. Needs contiguous destination storage and
+  // trivially copyable items; silently falls back to kScatterDirect
+  // otherwise.
+  kScatterStreaming,
+};
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// Whether Iterator walks one contiguous array, which StreamingScatter
+// needs to write whole cache lines through &*dst.
+template<typename Iterator>
+struct ContiguousStorage {
+  typedef typename std::remove_cv<
+    typename std::iterator_traits<Iterator>::value_type>::type Item;
+  static const bool value =
+    std::is_pointer<Iterator>::value ||
+    std::is_same<Iterator, typename std::vector<Item>::iterator>::value;
+};
+
+constexpr std::size_t
+gcd_size(std::size_t a, std::size_t b) {
+  return b == 0 ? a : gcd_size(b, a % b);
+}
+
+// One thread's digit counters, on cache lines of their own. The workers
+// count and scatter through these and touch the shared thread x partition
+// matrix only to publish their counts and fetch back their offsets, so no
+// increment ever lands on a line that another thread writes.
+class LocalCounters {
+ public:
+  explicit LocalCounters(int partitions) : _partitions(partitions) {
+    void* mem;
+    std::size_t bytes = (partitions * sizeof(std::size_t) + kCacheLineSize
+                         - 1) / kCacheLineSize * kCacheLineSize;
+    if (posix_memalign(&mem, kCacheLineSize, bytes) != 0)
+      throw std::bad_alloc();
+    _counters = static_cast<std::size_t*>(mem);
+    std::memset(_counters, 0, partitions * sizeof(std::size_t));
+  }
+  LocalCounters(const LocalCounters&) = delete;
+  ~LocalCounters() {
+    free(_counters);
+  }
+  std::size_t* data() { return _counters; }
+  std::size_t& operator[](std::size_t i) { return _counters[i]; }
+  // Copies the counters to row, once counting is done.
+  void publish(std::size_t* row) const {
+    std::memcpy(row, _counters, _partitions * sizeof(std::size_t));
+  }
+  // Takes back row, say the scatter offsets the prefix sum left there.
+  void fetch(const std::size_t* row) {
+    std::memcpy(_counters, row, _partitions * sizeof(std::size_t));
+  }
+
+ private:
+  std::size_t* _counters;
+  const int _partitions;
+};
+
+// Copies whole cache lines without pulling the destination into cache.
+// Both pointers must be kCacheLineSize aligned.
+static inline void
+stream_lines(void* dst, const void* src, std::size_t bytes) {
+#ifdef __SSE2__
+  __m128i* d = static_cast<__m128i*>(dst);
+  const __m128i* s = static_cast<const __m128i*>(src);
+  for (std::size_t i = 0; i < bytes / sizeof(__m128i); i++) {
+    _mm_stream_si128(d + i, _mm_load_si128(s + i));
+  }
+#else
+  std::memcpy(dst, src, bytes);
+#endif
+}
+
+// Software write-combining buffer for one scatter thread. Items pushed to
+// a partition must have consecutive destination indexes, which is what
+// the per thread prefix counters of the radix workers hand out. Items are
+// written directly until a partition reaches a cache line boundary, from
+// then on they are staged and flushed a batch of whole lines at a time.
+template<typename T>
+class StreamingScatter {
+ public:
+  // Smallest number of items that fills whole cache lines.
+  static constexpr std::size_t kBatch =
+    kCacheLineSize / gcd_size(kCacheLineSize, sizeof(T));
+
+  StreamingScatter(T* dst, int partitions)
+    : _dst(dst), _start(partitions), _count(partitions, 0) {
+    void* mem;
+    if (posix_memalign(&mem, kCacheLineSize,
+                       partitions * kBatch * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    _buffer = static_cast<char*>(mem);
+  }
+  StreamingScatter(const StreamingScatter&) = delete;
+  ~StreamingScatter() {
+    free(_buffer);
+  }
+
+  void push(int partition, std::size_t dst_idx, const T& item) {
+    std::size_t cnt = _count[partition];
+    char* slot;
+    if (cnt == 0) {
+      if (reinterpret_cast<std::uintptr_t>(_dst + dst_idx)
+          % kCacheLineSize != 0) {
+        std::memcpy(static_cast<void*>(_dst + dst_idx), &item, sizeof(T));
+        return;
+      }
+      _start[partition] = dst_idx;
+    }
+    slot = _buffer + (partition * kBatch + cnt) * sizeof(T);
+    std::memcpy(slot, &item, sizeof(T));
+    if (++cnt == kBatch) {
+      stream_lines(_dst + _start[partition],
+                   _buffer + partition * kBatch * sizeof(T),
+                   kBatch * sizeof(T));
+      cnt = 0;
+    }
+    _count[partition] = cnt;
+  }
+
+  // Writes out partially filled buffers and orders the streaming stores
+  // before anything the caller does next.
+  void flush() {
+    for (std::size_t p = 0; p < _count.size(); p++) {
+      if (_count[p] == 0)
+        continue;
+      std::memcpy(static_cast<void*>(_dst + _start[p]),
+                  _buffer + p * kBatch * sizeof(T),
+                  _count[p] * sizeof(T));
+      _count[p] = 0;
+    }
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+  }
+
+ private:
+  T* _dst;
+  char* _buffer;
+  std::vector<std::size_t> _start;
+  std::vector<std::size_t> _count;
+};
+
+} // namespace radix_hash
+
+#endif
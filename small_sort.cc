@@ -0,0 +1,154 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <mutex>
+#include "small_sort.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SMALL_SORT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace radix_hash {
+
+#ifdef SMALL_SORT_X86
+
+// Lanes i of a register with (i & x) == 0, x one of 1, 2 and 4.
+static inline unsigned clear_lanes(int x) {
+  return x == 1 ? 0x55 : x == 2 ? 0x33 : 0x0F;
+}
+
+// Lanes of register r that keep the smaller key in the bitonic step
+// (size, step): lane i sits at position 8r + i and meets position
+// (8r + i) ^ step, and its run of length size sorts ascending when the
+// size bit of its position is clear.
+static inline __mmask8 min_lanes(int r, int step, int size) {
+  unsigned ascending = size < 8 ? clear_lanes(size) :
+    ((r * 8) & size) ? 0 : 0xFF;
+  return static_cast<__mmask8>(~(clear_lanes(step) ^ ascending));
+}
+
+// GCC flags the intrinsics' own undefined vectors.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+// Bitonic sort of 8 * R keys held in R registers, payloads following their
+// keys through the same blends. Lanes past n are padded with ~0 keys and
+// sort to the end.
+template<int R>
+__attribute__((target("avx512f")))
+static void sort_avx512(uint64_t* keys, uint64_t* payloads, std::size_t n) {
+  const __m512i pad = _mm512_set1_epi64(-1);
+  __m512i k[R], v[R];
+
+  for (int r = 0; r < R; r++) {
+    std::size_t lanes = n > 8u * r ? n - 8u * r : 0;
+    __mmask8 m = lanes >= 8 ? 0xFF : static_cast<__mmask8>((1u << lanes) - 1);
+    k[r] = _mm512_mask_loadu_epi64(pad, m, keys + 8 * r);
+    v[r] = _mm512_maskz_loadu_epi64(m, payloads + 8 * r);
+  }
+
+#pragma GCC unroll 8
+  for (int size = 2; size <= 8 * R; size <<= 1) {
+#pragma GCC unroll 8
+    for (int step = size >> 1; step > 0; step >>= 1) {
+      if (step >= 8) {
+        // Whole registers meet; a run of size >= 16 has one direction
+        // per register.
+        int d = step >> 3;
+#pragma GCC unroll 8
+        for (int r = 0; r < R; r++) {
+          if (r & d)
+            continue;
+          int p = r | d;
+          bool ascending = ((r * 8) & size) == 0;
+          __mmask8 swap = ascending ?
+            _mm512_cmplt_epu64_mask(k[p], k[r]) :
+            _mm512_cmplt_epu64_mask(k[r], k[p]);
+          __m512i kr = _mm512_mask_blend_epi64(swap, k[r], k[p]);
+          __m512i vr = _mm512_mask_blend_epi64(swap, v[r], v[p]);
+          k[p] = _mm512_mask_blend_epi64(swap, k[p], k[r]);
+          v[p] = _mm512_mask_blend_epi64(swap, v[p], v[r]);
+          k[r] = kr;
+          v[r] = vr;
+        }
+        continue;
+      }
+      const __m512i partner = step == 1 ?
+        _mm512_set_epi64(6, 7, 4, 5, 2, 3, 0, 1) : step == 2 ?
+        _mm512_set_epi64(5, 4, 7, 6, 1, 0, 3, 2) :
+        _mm512_set_epi64(3, 2, 1, 0, 7, 6, 5, 4);
+#pragma GCC unroll 8
+      for (int r = 0; r < R; r++) {
+        __m512i pk = _mm512_permutexvar_epi64(partner, k[r]);
+        __m512i pv = _mm512_permutexvar_epi64(partner, v[r]);
+        __mmask8 keep_min = min_lanes(r, step, size);
+        // Ties take nothing on either side, so a lane and its partner
+        // never both end up with the same payload.
+        __mmask8 take = (keep_min & _mm512_cmplt_epu64_mask(pk, k[r])) |
+          (~keep_min & _mm512_cmpgt_epu64_mask(pk, k[r]));
+        k[r] = _mm512_mask_blend_epi64(take, k[r], pk);
+        v[r] = _mm512_mask_blend_epi64(take, v[r], pv);
+      }
+    }
+  }
+
+  for (int r = 0; r < R; r++) {
+    std::size_t lanes = n > 8u * r ? n - 8u * r : 0;
+    __mmask8 m = lanes >= 8 ? 0xFF : static_cast<__mmask8>((1u << lanes) - 1);
+    _mm512_mask_storeu_epi64(keys + 8 * r, m, k[r]);
+    _mm512_mask_storeu_epi64(payloads + 8 * r, m, v[r]);
+  }
+}
+
+__attribute__((target("avx512f")))
+static void small_sort_avx512(uint64_t* keys, uint64_t* payloads,
+                              std::size_t n) {
+  if (n <= 8)
+    sort_avx512<1>(keys, payloads, n);
+  else if (n <= 16)
+    sort_avx512<2>(keys, payloads, n);
+  else if (n <= 32)
+    sort_avx512<4>(keys, payloads, n);
+  else
+    sort_avx512<8>(keys, payloads, n);
+}
+#pragma GCC diagnostic pop
+#endif
+
+static SmallSortKernel g_kernel = nullptr;
+static std::once_flag g_kernel_once;
+
+static void detect_kernel() {
+#ifdef SMALL_SORT_X86
+  if (__builtin_cpu_supports("avx512f"))
+    g_kernel = small_sort_avx512;
+#endif
+}
+
+SmallSortKernel small_sort_kernel() {
+  std::call_once(g_kernel_once, detect_kernel);
+  return g_kernel;
+}
+
+void set_small_sort_enabled(bool enabled) {
+  std::call_once(g_kernel_once, detect_kernel);
+  g_kernel = nullptr;
+  if (enabled)
+    detect_kernel();
+}
+
+} // namespace radix_hash
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SMALL_SORT_H
+#define SMALL_SORT_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "radix_key.h"
+
+namespace radix_hash {
+
+// Sorts keys[0, n) ascending, n <= kSmallSortMax, moving payloads[i] along
+// with keys[i]. Equal keys come out in no particular order. No key may be
+// ~0, the value that pads the network.
+typedef void (*SmallSortKernel)(uint64_t* keys, uint64_t* payloads,
+                                std::size_t n);
+
+// Buckets within [kSmallSortMin, kSmallSortMax] go through the sorting
+// networks; below, insertion sort is as fast.
+static const std::size_t kSmallSortMin = 8;
+static const std::size_t kSmallSortMax = 64;
+
+// The sorting network kernel for this CPU, nullptr if there is none and
+// callers should insertion sort.
+SmallSortKernel small_sort_kernel();
+// Turns the kernel off, or back on if the CPU has one, for tests and
+// benchmarks; must not race with running sorts.
+void set_small_sort_enabled(bool enabled);
+
+// Sorts dst[begin, end) by radix_bits(item_key(item)) through the network
+// kernel and returns true, or returns false without touching the range when
+// there is no kernel or the bucket does not suit it. Items are permuted
+// along the cycles of the sorted order, each moved once.
+template<typename RandomAccessIterator>
+static inline bool small_sort(RandomAccessIterator dst,
+                              std::size_t begin,
+                              std::size_t end) {
+  std::size_t n = end - begin, j, k;
+  SmallSortKernel kernel = small_sort_kernel();
+  uint64_t keys[kSmallSortMax], rows[kSmallSortMax];
+
+  if (n < kSmallSortMin || n > kSmallSortMax || !kernel)
+    return false;
+  for (std::size_t i = 0; i < n; i++) {
+    keys[i] = radix_bits(item_key(dst[begin + i]));
+    if (keys[i] == ~0ULL)
+      return false;
+    rows[i] = i;
+  }
+  kernel(keys, rows, n);
+
+  for (std::size_t i = 0; i < n; i++) {
+    if (rows[i] == i)
+      continue;
+    auto tmp = std::move(dst[begin + i]);
+    for (j = i; rows[j] != i; j = k) {
+      k = rows[j];
+      dst[begin + j] = std::move(dst[begin + k]);
+      rows[j] = j;
+    }
+    dst[begin + j] = std::move(tmp);
+    rows[j] = j;
+  }
+  return true;
+}
+
+// small_sort() for the hash and row arrays of radix_index.h.
+template<typename Row>
+static inline bool small_sort(std::size_t* hashes,
+                              Row* rows,
+                              std::size_t begin,
+                              std::size_t end) {
+  std::size_t n = end - begin;
+  SmallSortKernel kernel = small_sort_kernel();
+  uint64_t keys[kSmallSortMax], payloads[kSmallSortMax];
+
+  if (n < kSmallSortMin || n > kSmallSortMax || !kernel)
+    return false;
+  for (std::size_t i = 0; i < n; i++) {
+    if (hashes[begin + i] == ~0ULL)
+      return false;
+    keys[i] = hashes[begin + i];
+    payloads[i] = rows[begin + i];
+  }
+  kernel(keys, payloads, n);
+  for (std::size_t i = 0; i < n; i++) {
+    hashes[begin + i] = keys[i];
+    rows[begin + i] = static_cast<Row>(payloads[i]);
+  }
+  return true;
+}
+
+} // namespace radix_hash
+
+#endif
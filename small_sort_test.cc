@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "small_sort.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Random keys drawn from range values, so small ranges repeat keys.
+static std::vector<std::pair<uint64_t, std::string>>
+create_items(std::size_t size, uint64_t range) {
+  std::default_random_engine generator(size * 131 + range);
+  std::uniform_int_distribution<uint64_t> distribution(0, range - 1);
+  std::vector<std::pair<uint64_t, std::string>> items(size);
+  for (std::size_t i = 0; i < size; i++) {
+    items[i].first = distribution(generator);
+    items[i].second = std::to_string(i);
+  }
+  return items;
+}
+
+TEST(small_sort_test, sorts_items_with_payloads) {
+  if (!radix_hash::small_sort_kernel())
+    return;
+  for (uint64_t range : {4ULL, 1000ULL, ~0ULL}) {
+    for (std::size_t size = radix_hash::kSmallSortMin;
+         size <= radix_hash::kSmallSortMax; size++) {
+      auto items = create_items(size, range);
+      auto expected = items;
+      std::vector<std::pair<uint64_t, std::string>> dst(items);
+      dst.insert(dst.begin(), std::make_pair(0ULL, std::string("head")));
+      ASSERT_TRUE(radix_hash::small_sort(dst.begin(), 1, size + 1));
+      EXPECT_EQ("head", dst[0].second);
+      dst.erase(dst.begin());
+      for (std::size_t i = 1; i < size; i++) {
+        ASSERT_LE(dst[i-1].first, dst[i].first);
+      }
+      // Each item moved along with its key, none lost or duplicated.
+      std::sort(expected.begin(), expected.end());
+      std::sort(dst.begin(), dst.end());
+      EXPECT_EQ(expected, dst);
+    }
+  }
+}
+
+TEST(small_sort_test, signed_keys) {
+  if (!radix_hash::small_sort_kernel())
+    return;
+  std::vector<int64_t> keys = {5, -3, 0, -9, 12, -1, 7, -100, 3, 2, -2};
+  auto expected = keys;
+  std::sort(expected.begin(), expected.end());
+  ASSERT_TRUE(radix_hash::small_sort(keys.begin(), 0, keys.size()));
+  EXPECT_EQ(expected, keys);
+}
+
+TEST(small_sort_test, falls_back) {
+  std::vector<uint64_t> keys(16, 1);
+  keys[3] = ~0ULL;
+  auto expected = keys;
+  // A key equal to the padding, and buckets outside the network sizes.
+  EXPECT_FALSE(radix_hash::small_sort(keys.begin(), 0, keys.size()));
+  EXPECT_FALSE(radix_hash::small_sort(keys.begin(), 4, 8));
+  EXPECT_EQ(expected, keys);
+
+  std::vector<uint64_t> large(radix_hash::kSmallSortMax + 1, 1);
+  EXPECT_FALSE(radix_hash::small_sort(large.begin(), 0, large.size()));
+
+  radix_hash::set_small_sort_enabled(false);
+  std::vector<uint64_t> plain(16, 2);
+  EXPECT_FALSE(radix_hash::small_sort(plain.begin(), 0, plain.size()));
+  radix_hash::set_small_sort_enabled(true);
+}
+
+TEST(small_sort_test, hash_and_row_arrays) {
+  if (!radix_hash::small_sort_kernel())
+    return;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution(0, 20);
+  for (std::size_t size = radix_hash::kSmallSortMin;
+       size <= radix_hash::kSmallSortMax; size++) {
+    std::vector<std::size_t> hashes(size);
+    std::vector<uint32_t> rows(size);
+    std::vector<std::pair<std::size_t, uint32_t>> expected(size), got(size);
+    for (std::size_t i = 0; i < size; i++) {
+      hashes[i] = distribution(generator);
+      rows[i] = static_cast<uint32_t>(i);
+      expected[i] = std::make_pair(hashes[i], rows[i]);
+    }
+    ASSERT_TRUE(radix_hash::small_sort(hashes.data(), rows.data(), 0, size));
+    for (std::size_t i = 0; i < size; i++) {
+      if (i > 0) {
+        ASSERT_LE(hashes[i-1], hashes[i]);
+      }
+      got[i] = std::make_pair(hashes[i], rows[i]);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(got.begin(), got.end());
+    EXPECT_EQ(expected, got);
+  }
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_file.h"
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void throw_errno(const char* what) {
+  throw std::system_error(errno, std::system_category(), what);
+}
+
+SpillFile::SpillFile(const std::string& dir) : _size(0) {
+  std::string path = (dir.empty() ? default_dir() : dir) +
+    "/funnelhash_spill_XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+  _fd = mkstemp(name.data());
+  if (_fd < 0)
+    throw_errno("mkstemp");
+  unlink(name.data());
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+SpillFile::~SpillFile() {
+  close(_fd);
+}
+
+std::size_t SpillFile::append(const char* data, std::size_t size) {
+  std::size_t offset = _size;
+  ssize_t written;
+  while (size > 0) {
+    written = pwrite(_fd, data, size, _size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("pwrite");
+    }
+    data += written;
+    size -= written;
+    _size += written;
+  }
+  return offset;
+}
+
+void SpillFile::read(std::size_t offset, char* data, std::size_t size) const {
+  ssize_t got;
+  while (size > 0) {
+    got = pread(_fd, data, size, offset);
+    if (got < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("pread");
+    }
+    if (got == 0)
+      throw std::system_error(EIO, std::system_category(), "short pread");
+    data += got;
+    size -= got;
+    offset += got;
+  }
+}
+
+void SpillFile::will_read(std::size_t offset, std::size_t size) const {
+#ifdef POSIX_FADV_WILLNEED
+  posix_fadvise(_fd, offset, size, POSIX_FADV_WILLNEED);
+#else
+  (void)offset;
+  (void)size;
+#endif
+}
+
+std::string SpillFile::default_dir() {
+  const char* dir = std::getenv("TMPDIR");
+  return dir && *dir ? dir : "/tmp";
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPILL_FILE_H
+#define SPILL_FILE_H 1
+
+#include <cstddef>
+#include <string>
+
+// An unnamed temporary file that is only ever appended to and read back
+// with positioned reads. It is unlinked as soon as it is created, so the
+// space goes back to the file system however the process ends. I/O errors
+// throw std::system_error.
+class SpillFile {
+ public:
+  // Creates the file in dir, or in default_dir() when dir is empty.
+  explicit SpillFile(const std::string& dir = std::string());
+  SpillFile(const SpillFile&) = delete;
+  ~SpillFile();
+  // Writes data[0, size) at the end of the file, returns its offset.
+  std::size_t append(const char* data, std::size_t size);
+  // Reads [offset, offset + size) into data.
+  void read(std::size_t offset, char* data, std::size_t size) const;
+  // Hints that [offset, offset + size) is read soon.
+  void will_read(std::size_t offset, std::size_t size) const;
+  std::size_t size() const { return _size; }
+  // $TMPDIR, or /tmp without it.
+  static std::string default_dir();
+ private:
+  int _fd;
+  std::size_t _size;
+};
+
+#endif
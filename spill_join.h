@@ -0,0 +1,421 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPILL_JOIN_H
+#define SPILL_JOIN_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hashjoin.h"
+#include "spill_file.h"
+
+namespace radix_hash {
+
+// Byte layout of spilled keys and values: raw bytes for trivially copyable
+// types, a 32 bit length and the characters for std::string.
+template<typename T, typename Enable = void>
+struct SpillCodec {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "spilled types must be trivially copyable or std::string");
+  static std::size_t size(const T&) { return sizeof(T); }
+  static char* write(char* out, const T& v) {
+    std::memcpy(out, &v, sizeof(T));
+    return out + sizeof(T);
+  }
+  static const char* read(const char* in, T* v) {
+    std::memcpy(v, in, sizeof(T));
+    return in + sizeof(T);
+  }
+};
+
+template<>
+struct SpillCodec<std::string> {
+  static std::size_t size(const std::string& v) {
+    return sizeof(uint32_t) + v.size();
+  }
+  static char* write(char* out, const std::string& v) {
+    uint32_t len = static_cast<uint32_t>(v.size());
+    std::memcpy(out, &len, sizeof(len));
+    std::memcpy(out + sizeof(len), v.data(), len);
+    return out + sizeof(len) + len;
+  }
+  static const char* read(const char* in, std::string* v) {
+    uint32_t len;
+    std::memcpy(&len, in, sizeof(len));
+    v->assign(in + sizeof(len), len);
+    return in + sizeof(len) + len;
+  }
+};
+
+// Multiplicative mix of a hash, as in BlockedBloomFilter. std::hash of an
+// integer is the integer itself, whose top bits are all zero, so spilling
+// on the raw hash would put every small key in partition 0. The multiply
+// is odd, hence a bijection: equal keys still meet on equal hashes.
+inline std::size_t spill_mix(std::size_t hash) {
+  return hash * 0x9E3779B97F4A7C15ULL;
+}
+
+struct SpillExtent {
+  std::size_t offset;
+  std::size_t size;
+};
+
+// Appends (hash, key, value) records to the partition of the top
+// partition_bits of their mixed hash (see spill_mix). Each partition fills a buffer of up to
+// block_size bytes that goes to the end of file once full, so the file is
+// written sequentially in blocks and a partition reads back as a list of
+// extents. The buffers together never reserve more than buffer_budget
+// bytes, bar a single record larger than that: a buffer that has to grow
+// past it first writes out other, well filled buffers.
+template<typename Key, typename Value>
+class SpillPartitioner {
+ public:
+  SpillPartitioner(SpillFile* file, int partition_bits,
+                   std::size_t block_size, std::size_t buffer_budget)
+    : _file(file), _partition_bits(partition_bits),
+      _block_size(std::min(block_size, buffer_budget)),
+      _buffer_budget(buffer_budget),
+      _buffers(std::size_t(1) << partition_bits),
+      _extents(std::size_t(1) << partition_bits),
+      _items(std::size_t(1) << partition_bits, 0) {}
+
+  // Records are stored with the mixed hash.
+  void add(std::size_t hash, const Key& key, const Value& value) {
+    hash = spill_mix(hash);
+    std::size_t p = _partition_bits ? hash >> (64 - _partition_bits) : 0;
+    std::size_t size = sizeof(hash) + SpillCodec<Key>::size(key) +
+      SpillCodec<Value>::size(value);
+    std::vector<char>& buffer = _buffers[p];
+    char* out;
+    if (buffer.size() + size > _block_size)
+      flush(p);
+    reserve(p, buffer.size() + size);
+    buffer.resize(buffer.size() + size);
+    out = &buffer[buffer.size() - size];
+    out = SpillCodec<std::size_t>::write(out, hash);
+    out = SpillCodec<Key>::write(out, key);
+    SpillCodec<Value>::write(out, value);
+    _items[p]++;
+  }
+
+  // Writes out the partially filled blocks and frees the buffers.
+  void flush() {
+    for (std::size_t p = 0; p < _buffers.size(); p++)
+      release(p);
+  }
+
+  // Most bytes the buffers held reserved at once.
+  std::size_t peak_buffered() const { return _peak; }
+
+  int partitions() const { return static_cast<int>(_extents.size()); }
+  const std::vector<SpillExtent>& extents(int p) const { return _extents[p]; }
+  std::size_t items(int p) const { return _items[p]; }
+  std::size_t bytes(int p) const {
+    std::size_t bytes = 0;
+    for (auto&& e : _extents[p])
+      bytes += e.size;
+    return bytes;
+  }
+
+ private:
+  void flush(std::size_t p) {
+    std::vector<char>& buffer = _buffers[p];
+    if (buffer.empty())
+      return;
+    _extents[p].push_back(SpillExtent{
+        _file->append(buffer.data(), buffer.size()), buffer.size()});
+    buffer.clear();
+  }
+
+  void release(std::size_t p) {
+    flush(p);
+    _reserved -= _buffers[p].capacity();
+    std::vector<char>().swap(_buffers[p]);
+  }
+
+  // Grows buffer p to hold bytes. Buffers at least half the average size
+  // are written out round robin until the growth fits the budget, which
+  // keeps the writes large without searching for the largest buffer.
+  void reserve(std::size_t p, std::size_t bytes) {
+    std::vector<char>& buffer = _buffers[p];
+    std::size_t cap = buffer.capacity(), grown, others;
+    if (bytes <= cap)
+      return;
+    grown = 2 * cap < kMinBufferSize ? kMinBufferSize : 2 * cap;
+    grown = std::max(std::min(grown, _block_size), bytes);
+    while (_reserved - cap + grown > _buffer_budget && _reserved > cap) {
+      others = _reserved - cap;
+      _clock = (_clock + 1) % _buffers.size();
+      if (_clock != p && _buffers[_clock].capacity() > 0 &&
+          _buffers[_clock].capacity() >= others / (2 * _buffers.size()))
+        release(_clock);
+    }
+    buffer.reserve(grown);
+    _reserved += buffer.capacity() - cap;
+    _peak = std::max(_peak, _reserved);
+  }
+
+  static const std::size_t kMinBufferSize = 4 << 10;
+
+  SpillFile* _file;
+  const int _partition_bits;
+  const std::size_t _block_size;
+  const std::size_t _buffer_budget;
+  std::size_t _reserved = 0;
+  std::size_t _peak = 0;
+  std::size_t _clock = 0;
+  std::vector<std::vector<char>> _buffers;
+  std::vector<std::vector<SpillExtent>> _extents;
+  std::vector<std::size_t> _items;
+};
+
+// Reads partition p of parts back from file, extent by extent.
+template<typename Key, typename Value>
+std::vector<char> read_spilled(const SpillFile& file,
+                               const SpillPartitioner<Key, Value>& parts,
+                               int p) {
+  std::vector<char> raw(parts.bytes(p));
+  std::size_t pos = 0;
+  for (auto&& e : parts.extents(p))
+    file.will_read(e.offset, e.size);
+  for (auto&& e : parts.extents(p)) {
+    file.read(e.offset, raw.data() + pos, e.size);
+    pos += e.size;
+  }
+  return raw;
+}
+
+// Decodes records read by read_spilled. Their mixed hashes are rotated
+// left by rotate bits, which moves the partition bits every record of a
+// spill partition shares to the bottom, so the in memory sort partitions on
+// fresh bits.
+template<typename Key, typename Value>
+std::vector<std::tuple<std::size_t, Key, Value>>
+decode_spilled(const std::vector<char>& raw, std::size_t items, int rotate) {
+  std::vector<std::tuple<std::size_t, Key, Value>> tuples(items);
+  const char* in = raw.data();
+  std::size_t h;
+  for (auto&& t : tuples) {
+    in = SpillCodec<std::size_t>::read(in, &h);
+    std::get<0>(t) = rotate ? (h << rotate) | (h >> (64 - rotate)) : h;
+    in = SpillCodec<Key>::read(in, &std::get<1>(t));
+    in = SpillCodec<Value>::read(in, &std::get<2>(t));
+  }
+  return tuples;
+}
+
+} // namespace radix_hash
+
+// HashMergeJoin for inputs that do not fit in memory. Both sides are
+// scattered on their top mixed hash bits into spill files, with enough
+// partitions that one pair of partitions, sorted, fits memory_budget
+// bytes. for_each then sort-merge joins the pairs one at a time, the next
+// pair read from disk while the current one is joined. While spilling,
+// the write buffers of each side together stay within memory_budget. A
+// partition that skew makes larger than the budget is still joined in
+// memory.
+template<typename RIter, typename SIter>
+class SpillingHashJoin {
+  static_assert(std::is_same<
+                typename RIter::value_type::first_type,
+                typename SIter::value_type::first_type>::value,
+                "RIter and SIter key type must be the same");
+
+  typedef typename RIter::value_type::first_type Key;
+  typedef typename RIter::value_type::second_type RValue;
+  typedef typename SIter::value_type::second_type SValue;
+  typedef typename std::tuple<std::size_t, Key, RValue> RTuple;
+  typedef typename std::tuple<std::size_t, Key, SValue> STuple;
+  typedef radix_hash::SpillPartitioner<Key, RValue> RParts;
+  typedef radix_hash::SpillPartitioner<Key, SValue> SParts;
+
+  static const int kMaxSpillBits = 12;
+  static const std::size_t kMinBlockSize = 64 << 10;
+  static const std::size_t kMaxBlockSize = 4 << 20;
+  // Items looked at to guess the size of a spilled record.
+  static const std::size_t kSampleSize = 1024;
+
+  struct SpilledPair {
+    std::vector<char> r_raw;
+    std::vector<char> s_raw;
+  };
+
+ public:
+  SpillingHashJoin(RIter r_begin, RIter r_end,
+                   SIter s_begin, SIter s_end,
+                   std::size_t memory_budget,
+                   unsigned int num_threads = 1,
+                   const std::string& spill_dir = std::string())
+    : _r_file(new SpillFile(spill_dir)), _s_file(new SpillFile(spill_dir)),
+      _num_threads(num_threads) {
+    std::size_t r_size = std::distance(r_begin, r_end);
+    std::size_t s_size = std::distance(s_begin, s_end);
+    // A pair in memory holds the read ahead bytes of the next pair, its own
+    // bytes and tuples, and the sorted tuples.
+    double need = r_size * (2.0 * record_size(r_begin, r_end) +
+                            2.0 * sizeof(RTuple)) +
+      s_size * (2.0 * record_size(s_begin, s_end) + 2.0 * sizeof(STuple));
+    std::size_t block_size;
+
+    _spill_bits = 0;
+    while (_spill_bits < kMaxSpillBits &&
+           need / (std::size_t(1) << _spill_bits) > memory_budget)
+      _spill_bits++;
+    // Blocks aim for an even share of the budget, but no less than
+    // kMinBlockSize. Once the partitions outnumber that, the partitioner
+    // writes out buffers early to keep their total within the budget.
+    block_size = memory_budget >> _spill_bits;
+    if (block_size < kMinBlockSize)
+      block_size = kMinBlockSize;
+    if (block_size > kMaxBlockSize)
+      block_size = kMaxBlockSize;
+
+    _r_parts.reset(new RParts(_r_file.get(), _spill_bits, block_size,
+                              memory_budget));
+    for (; r_begin != r_end; ++r_begin)
+      _r_parts->add(std::hash<Key>{}(r_begin->first), r_begin->first,
+                    r_begin->second);
+    _r_parts->flush();
+    _s_parts.reset(new SParts(_s_file.get(), _spill_bits, block_size,
+                              memory_budget));
+    for (; s_begin != s_end; ++s_begin)
+      _s_parts->add(std::hash<Key>{}(s_begin->first), s_begin->first,
+                    s_begin->second);
+    _s_parts->flush();
+  }
+
+  int partitions() const { return 1 << _spill_bits; }
+
+  // Bytes both sides spilled to partition p.
+  std::size_t partition_bytes(int p) const {
+    return _r_parts->bytes(p) + _s_parts->bytes(p);
+  }
+
+  // Most bytes the write buffers of either side held at once.
+  std::size_t peak_buffered() const {
+    return std::max(_r_parts->peak_buffered(), _s_parts->peak_buffered());
+  }
+
+  // Reports the join in Mode (see JoinMode) through fn, joining one
+  // spill partition pair at a time on the constructor's num_threads.
+  template<JoinMode Mode, typename Function>
+  void for_each(Function fn) {
+    std::future<SpilledPair> next;
+    SpilledPair pair;
+    int p = next_pair(0, Mode);
+
+    if (p < partitions())
+      next = std::async(std::launch::async, &SpillingHashJoin::read_pair,
+                        this, p);
+    while (p < partitions()) {
+      pair = next.get();
+      int q = next_pair(p + 1, Mode);
+      if (q < partitions())
+        next = std::async(std::launch::async, &SpillingHashJoin::read_pair,
+                          this, q);
+      join_pair<Mode>(p, &pair, fn);
+      p = q;
+    }
+  }
+
+  template<typename Function>
+  void for_each_match(Function fn) {
+    for_each<kInnerJoin>(fn);
+  }
+
+ private:
+  template<typename Iter>
+  static double record_size(Iter begin, Iter end) {
+    typedef typename Iter::value_type::second_type Value;
+    std::size_t bytes = 0, n = 0;
+    for (; begin != end && n < kSampleSize; ++begin, ++n) {
+      bytes += sizeof(std::size_t) +
+        radix_hash::SpillCodec<Key>::size(begin->first) +
+        radix_hash::SpillCodec<Value>::size(begin->second);
+    }
+    return n ? static_cast<double>(bytes) / n : 0.0;
+  }
+
+  // First partition from p on that can produce output in mode.
+  int next_pair(int p, JoinMode mode) const {
+    for (; p < partitions(); p++) {
+      bool r = _r_parts->items(p) > 0, s = _s_parts->items(p) > 0;
+      if (mode == kFullOuterJoin ? r || s :
+          mode == kInnerJoin || mode == kSemiJoin ? r && s : r)
+        return p;
+    }
+    return p;
+  }
+
+  SpilledPair read_pair(int p) const {
+    SpilledPair pair;
+    pair.r_raw = radix_hash::read_spilled(*_r_file, *_r_parts, p);
+    pair.s_raw = radix_hash::read_spilled(*_s_file, *_s_parts, p);
+    return pair;
+  }
+
+  template<typename Tuple>
+  std::vector<Tuple> sort_spilled(std::vector<char>* raw, std::size_t items,
+                                  int partition_bits) {
+    typedef typename std::tuple_element<2, Tuple>::type Value;
+    std::vector<Tuple> tuples = radix_hash::decode_spilled<Key, Value>(
+        *raw, items, _spill_bits);
+    std::vector<Tuple> sorted(tuples.size());
+    std::vector<char>().swap(*raw);
+    if (!tuples.empty()) {
+      radix_hash::radix_non_inplace_par<Key, Value, radix_hash::Prehashed>(
+          tuples.begin(), tuples.end(), sorted.begin(), _num_threads,
+          partition_bits);
+    }
+    return sorted;
+  }
+
+  template<JoinMode Mode, typename Function>
+  void join_pair(int p, SpilledPair* pair, Function& fn) {
+    std::size_t r_items = _r_parts->items(p), s_items = _s_parts->items(p);
+    int partition_bits =
+      radix_hash::optimal_partition(std::max(r_items, s_items));
+    std::vector<RTuple> r_sorted =
+      sort_spilled<RTuple>(&pair->r_raw, r_items, partition_bits);
+    std::vector<STuple> s_sorted =
+      sort_spilled<STuple>(&pair->s_raw, s_items, partition_bits);
+    merge_partitions_par<Mode>(r_sorted.begin(), r_sorted.end(),
+                               s_sorted.begin(), s_sorted.end(),
+                               partition_bits, fn, nullptr,
+                               radix_hash::tuned_threads(
+                                   _num_threads, r_items + s_items));
+  }
+
+  std::unique_ptr<SpillFile> _r_file;
+  std::unique_ptr<SpillFile> _s_file;
+  std::unique_ptr<RParts> _r_parts;
+  std::unique_ptr<SParts> _s_parts;
+  int _spill_bits;
+  unsigned int _num_threads;
+};
+
+#endif
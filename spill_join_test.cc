@@ -0,0 +1,130 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_join.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::vector<std::tuple<std::string, uint64_t, uint64_t>> Matches;
+
+TEST(spill_join_test, codec_round_trip) {
+  std::vector<char> buf(64);
+  std::string key = "spilled key", key_out;
+  uint64_t value = 42, value_out;
+  char* out = radix_hash::SpillCodec<std::string>::write(buf.data(), key);
+  radix_hash::SpillCodec<uint64_t>::write(out, value);
+  const char* in = radix_hash::SpillCodec<std::string>::read(buf.data(),
+                                                             &key_out);
+  radix_hash::SpillCodec<uint64_t>::read(in, &value_out);
+  EXPECT_EQ(key, key_out);
+  EXPECT_EQ(value, value_out);
+  EXPECT_EQ(sizeof(uint32_t) + key.size(),
+            radix_hash::SpillCodec<std::string>::size(key));
+}
+
+TEST(spill_join_test, matches_in_memory_join) {
+  int size = 50000;
+  KeyValVec r, s;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> distribution(0, size);
+  for (int i = 0; i < size / 2; i++)
+    r.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+  for (int i = 0; i < size; i++)
+    s.push_back(std::make_pair(std::to_string(distribution(generator)), i));
+
+  HashMergeJoin<KeyValVec::iterator, KeyValVec::iterator>
+    in_memory(r.begin(), r.end(), s.begin(), s.end(), 2);
+  // Far below the inputs, so they spill into many partitions.
+  SpillingHashJoin<KeyValVec::iterator, KeyValVec::iterator>
+    spilled(r.begin(), r.end(), s.begin(), s.end(), 256 << 10, 2);
+  EXPECT_GT(spilled.partitions(), 4);
+  // The write buffers stay within the budget, though an even share of it
+  // is below the smallest block size.
+  EXPECT_GT(spilled.partitions() * (64 << 10), 256 << 10);
+  EXPECT_GT(spilled.peak_buffered(), 0u);
+  EXPECT_LE(spilled.peak_buffered(), 256u << 10);
+
+  Matches expected, got;
+  std::mutex lock;
+  auto collect = [&lock](Matches* out) {
+    return [&lock, out](int, const std::string& key,
+                        uint64_t* r_val, uint64_t* s_val) {
+      std::lock_guard<std::mutex> guard(lock);
+      out->push_back(std::make_tuple(key, r_val ? *r_val : ~0ULL,
+                                     s_val ? *s_val : ~0ULL));
+    };
+  };
+  in_memory.for_each<kFullOuterJoin>(collect(&expected), 2);
+  spilled.for_each<kFullOuterJoin>(collect(&got));
+  std::sort(expected.begin(), expected.end());
+  std::sort(got.begin(), got.end());
+  ASSERT_FALSE(expected.empty());
+  EXPECT_EQ(expected, got);
+
+  std::size_t in_memory_anti = 0, spilled_anti = 0;
+  in_memory.for_each<kAntiJoin>([&](int, const std::string&, uint64_t) {
+      std::lock_guard<std::mutex> guard(lock);
+      in_memory_anti++;
+    }, 2);
+  spilled.for_each<kAntiJoin>([&](int, const std::string&, uint64_t) {
+      std::lock_guard<std::mutex> guard(lock);
+      spilled_anti++;
+    });
+  EXPECT_EQ(in_memory_anti, spilled_anti);
+}
+
+TEST(spill_join_test, integer_keys_spread_over_partitions) {
+  typedef std::vector<std::pair<uint64_t, uint64_t>> IntVec;
+  std::size_t size = 100000, budget = 256 << 10;
+  IntVec r, s;
+  std::unordered_map<uint64_t, std::size_t> r_count;
+  for (std::size_t i = 0; i < size; i++) {
+    r.push_back(std::make_pair(i, i));
+    s.push_back(std::make_pair(i * 7 % (2 * size), i));
+    r_count[i]++;
+  }
+
+  // std::hash of an integer is the integer, so the raw top hash bits of
+  // these keys are all zero.
+  SpillingHashJoin<IntVec::iterator, IntVec::iterator>
+    spilled(r.begin(), r.end(), s.begin(), s.end(), budget, 2);
+  ASSERT_GT(spilled.partitions(), 4);
+  std::size_t total = 0;
+  for (int p = 0; p < spilled.partitions(); p++) {
+    EXPECT_LE(spilled.partition_bytes(p), budget / 2);
+    total += spilled.partition_bytes(p);
+  }
+  EXPECT_GT(total, budget);
+
+  std::size_t expected = 0, got = 0;
+  std::mutex lock;
+  for (auto&& kv : s) {
+    auto it = r_count.find(kv.first);
+    if (it != r_count.end())
+      expected += it->second;
+  }
+  spilled.for_each_match([&](int, uint64_t key, uint64_t r_val, uint64_t) {
+      std::lock_guard<std::mutex> guard(lock);
+      EXPECT_EQ(key, r_val);
+      got++;
+    });
+  EXPECT_EQ(expected, got);
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STRING_SORT_H
+#define STRING_SORT_H 1
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include "key_prefix.h"
+#include "radix_hash.h"
+#include "thread_barrier.h"
+#include "thread_pool.h"
+#include "tuning.h"
+#include "work_stealing.h"
+
+// Buckets smaller than this are finished by multikey quicksort.
+static const std::size_t kStrQuicksortThreshold = 32;
+// Multikey quicksort insertion sorts below this many items.
+static const std::size_t kStrInsertionThreshold = 8;
+
+// What the string sort moves around: the 8 key bytes of the current window,
+// as radix_hash::key_prefix() packs them, and the input row of the item.
+// Records are 16 bytes whatever the item, and the cached bytes spare most
+// dereferences of the key body.
+typedef std::pair<uint64_t, std::size_t> StrRecord;
+
+template<typename Value>
+static inline const std::string&
+ss_key(const std::pair<std::string, Value>& item) {
+  return item.first;
+}
+
+static inline const std::string& ss_key(const std::string& item) {
+  return item;
+}
+
+// Byte depth of key plus one, 0 past the end, so that ended keys order
+// before keys continuing with '\0'.
+static inline int ss_char(const std::string& key, std::size_t depth) {
+  return depth < key.size() ?
+    static_cast<unsigned char>(key[depth]) + 1 : 0;
+}
+
+// Reloads the cached window of records [begin, end) to start at depth.
+template<typename RandomAccessIterator>
+static inline void ss_refill(RandomAccessIterator src, StrRecord* records,
+                             std::size_t begin, std::size_t end,
+                             std::size_t depth) {
+  for (std::size_t i = begin; i < end; i++) {
+    records[i].first =
+      radix_hash::key_prefix(ss_key(src[records[i].second]), depth);
+  }
+}
+
+// Every key of [begin, end) is at least depth long and shares the first
+// depth bytes, so only the suffixes are compared.
+template<typename RandomAccessIterator>
+void ss_insertion(RandomAccessIterator src, StrRecord* records,
+                  std::size_t begin, std::size_t end, std::size_t depth) {
+  for (std::size_t i = begin + 1; i < end; i++) {
+    for (std::size_t j = i; j > begin; j--) {
+      const std::string& a = ss_key(src[records[j].second]);
+      const std::string& b = ss_key(src[records[j-1].second]);
+      if (a.compare(depth, std::string::npos,
+                    b, depth, std::string::npos) >= 0)
+        break;
+      std::swap(records[j], records[j-1]);
+    }
+  }
+}
+
+// Multikey quicksort (Bentley and Sedgewick): a three way partition on the
+// byte at depth, then the equal part moves on to the next byte.
+template<typename RandomAccessIterator>
+void ss_multikey_qsort(RandomAccessIterator src, StrRecord* records,
+                       std::size_t begin, std::size_t end,
+                       std::size_t depth) {
+  while (end - begin >= kStrInsertionThreshold) {
+    int a = ss_char(ss_key(src[records[begin].second]), depth);
+    int b = ss_char(ss_key(src[records[begin + (end-begin)/2].second]),
+                    depth);
+    int c = ss_char(ss_key(src[records[end-1].second]), depth);
+    int pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+    std::size_t lt = begin, i = begin, gt = end;
+    while (i < gt) {
+      int ch = ss_char(ss_key(src[records[i].second]), depth);
+      if (ch < pivot)
+        std::swap(records[lt++], records[i++]);
+      else if (ch > pivot)
+        std::swap(records[i], records[--gt]);
+      else
+        i++;
+    }
+    ss_multikey_qsort(src, records, begin, lt, depth);
+    ss_multikey_qsort(src, records, gt, end, depth);
+    // Keys that ended here are equal.
+    if (pivot == 0)
+      return;
+    begin = lt;
+    end = gt;
+    depth++;
+  }
+  ss_insertion(src, records, begin, end, depth);
+}
+
+// MSD radix sort of records [s_begin, s_end), whose keys share their first
+// depth bytes and whose cache holds the window starting at depth & ~7.
+// Each pass scatters on one byte into 256 buckets; bucket 0 puts the keys
+// that ended before the ones holding a '\0'. The largest bucket is sorted
+// in the loop and the rest recursively, keeping the stack at log n deep,
+// and buckets of kStealThreshold items or more go to the scheduler.
+template<typename RandomAccessIterator>
+void ss_sort_bucket(RandomAccessIterator src, StrRecord* records,
+                    std::size_t s_begin, std::size_t s_end,
+                    std::size_t depth, SortTaskQueues* queues,
+                    int thread_id) {
+  StrRecord tmp_bucket;
+  std::size_t counters[256];
+  std::size_t indexes[256][2];
+  std::size_t idx_i, idx_j, mid, best;
+  uint64_t ors, ands, varying;
+  int shift, offset, iter, idx_c;
+
+  while (s_end - s_begin >= kStrQuicksortThreshold) {
+    offset = depth & 7;
+    shift = 56 - 8 * offset;
+    std::fill(counters, counters + 256, 0);
+    ors = 0;
+    ands = ~0ULL;
+    radix_hash::count_digits(records + s_begin, records + s_end, shift, 0xFF,
+                             counters, &ors, &ands);
+
+    // A single non zero byte: skip every byte of the window the keys
+    // share, as long as none of them may have ended.
+    varying = ors ^ ands;
+    if (counters[(ands >> shift) & 0xFF] == s_end - s_begin &&
+        ((ands >> shift) & 0xFF) != 0) {
+      while (offset < 8 && ((varying >> (56 - 8 * offset)) & 0xFF) == 0 &&
+             ((ands >> (56 - 8 * offset)) & 0xFF) != 0) {
+        offset++;
+        depth++;
+      }
+      if (offset == 8)
+        ss_refill(src, records, s_begin, s_end, depth);
+      continue;
+    }
+
+    indexes[0][0] = s_begin;
+    for (int i = 0; i < 255; i++) {
+      indexes[i][1] = indexes[i+1][0] = indexes[i][0] + counters[i];
+    }
+    indexes[255][1] = indexes[255][0] + counters[255];
+
+    iter = 0;
+    while (iter < 256) {
+      idx_i = indexes[iter][0];
+      if (idx_i >= indexes[iter][1]) {
+        iter++;
+        continue;
+      }
+      idx_c = (records[idx_i].first >> shift) & 0xFF;
+      if (idx_c == iter) {
+        indexes[iter][0]++;
+        continue;
+      }
+      tmp_bucket = records[idx_i];
+      do {
+        idx_c = (tmp_bucket.first >> shift) & 0xFF;
+        idx_j = indexes[idx_c][0]++;
+        std::swap(records[idx_j], tmp_bucket);
+      } while (idx_j > idx_i);
+    }
+
+    indexes[0][0] = s_begin;
+    for (int i = 1; i < 256; i++) {
+      indexes[i][0] = indexes[i-1][1];
+    }
+    // Keys that ended are equal and done; the '\0' ones carry on.
+    mid = std::partition(records + indexes[0][0], records + indexes[0][1],
+                         [&](const StrRecord& r) {
+                           return ss_key(src[r.second]).size() <= depth;
+                         }) - records;
+    indexes[0][0] = mid;
+    depth++;
+    if ((depth & 7) == 0)
+      ss_refill(src, records, mid, s_end, depth);
+
+    best = 0;
+    for (int i = 1; i < 256; i++) {
+      if (indexes[i][1] - indexes[i][0] > indexes[best][1] - indexes[best][0])
+        best = i;
+    }
+    for (std::size_t i = 0; i < 256; i++) {
+      if (i == best || indexes[i][1] - indexes[i][0] < 2)
+        continue;
+      if (indexes[i][1] - indexes[i][0] >= kStealThreshold) {
+        queues->push(thread_id, SortTask{indexes[i][0], indexes[i][1],
+              static_cast<int>(depth), false});
+      } else {
+        ss_sort_bucket(src, records, indexes[i][0], indexes[i][1], depth,
+                       queues, thread_id);
+      }
+    }
+    s_begin = indexes[best][0];
+    s_end = indexes[best][1];
+  }
+  if (s_end - s_begin > 1)
+    ss_multikey_qsort(src, records, s_begin, s_end, depth);
+}
+
+// Task loop of the string sort; SortTask::mask_bits holds the byte depth
+// of the task. The top level partitions share their first byte but start
+// at depth 0, where a recount finds it constant and skips it.
+template<typename RandomAccessIterator>
+void ss_sort_p(RandomAccessIterator src, StrRecord* records,
+               SortTaskQueues* queues, int thread_id) {
+  SortTask task;
+
+  while (queues->next(thread_id, &task)) {
+    ss_sort_bucket(src, records, task.begin, task.end,
+                   static_cast<std::size_t>(task.mask_bits), queues,
+                   thread_id);
+    queues->finish();
+  }
+}
+
+// Lexicographic MSD radix sort of std::string keys, either bare strings or
+// the first member of std::pair<std::string, Value> items, in
+// std::string::operator< order. Writes the sorted items to dst and leaves
+// [begin, end) untouched; equal keys come out in no particular order.
+//
+// The threads build a (key prefix, row) record per item, partition the
+// records on their first byte with the PARADIS permutation of
+// radix_hash.h and sort the 256 partitions through the work stealing
+// scheduler. Only the records move until the final gather copies each
+// item once.
+template <typename RandomAccessIterator, typename OutputIterator>
+void radix_str_sort(RandomAccessIterator begin,
+                    RandomAccessIterator end,
+                    OutputIterator dst,
+                    ThreadPool* pool,
+                    int num_threads) {
+  std::size_t input_num = std::distance(begin, end);
+  std::size_t thread_partition = input_num / num_threads;
+  std::vector<StrRecord> records(input_num);
+  ThreadBarrier barrier(num_threads);
+  radix_hash::ParadisState state(256, num_threads);
+  SortTaskQueues queues(num_threads, &state.indexes, 0);
+
+  run_on_threads(pool, num_threads, [&](int thread_id) {
+      std::size_t t_begin = thread_id * thread_partition;
+      std::size_t t_end = thread_id == num_threads - 1 ?
+        input_num : (thread_id + 1) * thread_partition;
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        records[i] = StrRecord(radix_hash::key_prefix(ss_key(begin[i])), i);
+      }
+      radix_hash::radix_paradis_worker(records.begin(), t_begin, t_end,
+                                       thread_id, num_threads, &barrier,
+                                       &state, 256, 56);
+      ss_sort_p(begin, records.data(), &queues, thread_id);
+      barrier.wait();
+      for (std::size_t i = t_begin; i < t_end; i++) {
+        dst[i] = begin[records[i].second];
+      }
+    });
+}
+
+template <typename RandomAccessIterator, typename OutputIterator>
+void radix_str_sort(RandomAccessIterator begin,
+                    RandomAccessIterator end,
+                    OutputIterator dst,
+                    int num_threads) {
+  radix_str_sort(begin, end, dst, nullptr,
+                 radix_hash::tuned_threads(num_threads,
+                                           std::distance(begin, end)));
+}
+
+template <typename RandomAccessIterator, typename OutputIterator>
+void radix_str_sort(RandomAccessIterator begin,
+                    RandomAccessIterator end,
+                    OutputIterator dst,
+                    ThreadPool& pool) {
+  radix_str_sort(begin, end, dst, &pool, pool.size());
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "string_sort.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::pair<std::string, int> StrItem;
+
+static void expect_sorted(const std::vector<StrItem>& input,
+                          int num_threads) {
+  std::vector<StrItem> sorted(input.size());
+  std::vector<StrItem> std_sorted = input;
+  radix_str_sort(input.begin(), input.end(), sorted.begin(), num_threads);
+  std::sort(std_sorted.begin(), std_sorted.end(),
+            [](const StrItem& a, const StrItem& b) {
+              return a.first < b.first;
+            });
+  ASSERT_EQ(std_sorted.size(), sorted.size());
+  for (std::size_t i = 0; i < sorted.size(); i++) {
+    ASSERT_EQ(std_sorted[i].first, sorted[i].first) << "at " << i;
+  }
+  // Every input row comes out exactly once.
+  std::vector<int> rows;
+  for (auto&& item : sorted)
+    rows.push_back(item.second);
+  std::sort(rows.begin(), rows.end());
+  for (std::size_t i = 0; i < rows.size(); i++) {
+    ASSERT_EQ(static_cast<int>(i), rows[i]);
+  }
+}
+
+TEST(string_sort_test, random_strings) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> length(0, 24);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<StrItem> input;
+
+  for (int i = 0; i < 100003; i++) {
+    std::string s(length(generator), ' ');
+    for (auto&& c : s)
+      c = static_cast<char>(byte(generator));
+    input.push_back(StrItem(s, i));
+  }
+  expect_sorted(input, 1);
+  expect_sorted(input, 4);
+}
+
+TEST(string_sort_test, nul_and_empty_keys) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> length(0, 12);
+  std::uniform_int_distribution<int> byte(0, 2);
+  std::vector<StrItem> input;
+
+  // Mostly '\0' bytes: ended keys have to order before '\0' ones.
+  for (int i = 0; i < 50000; i++) {
+    std::string s(length(generator), '\0');
+    for (auto&& c : s)
+      c = static_cast<char>(byte(generator) == 2 ? 'a' : '\0');
+    input.push_back(StrItem(s, i));
+  }
+  expect_sorted(input, 1);
+  expect_sorted(input, 3);
+}
+
+TEST(string_sort_test, long_common_prefixes) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> length(0, 40);
+  std::uniform_int_distribution<int> tail(0, 100000);
+  std::vector<StrItem> input;
+
+  // Prefixes longer than the cached window, and of every length around it.
+  for (int i = 0; i < 60000; i++) {
+    std::string s = std::string(length(generator), 'x') +
+      std::to_string(tail(generator));
+    if (i % 5 == 0)
+      s = std::string(i % 37, 'x');
+    input.push_back(StrItem(s, i));
+  }
+  expect_sorted(input, 1);
+  expect_sorted(input, 2);
+}
+
+TEST(string_sort_test, bare_strings) {
+  std::vector<std::string> input = {"pear", "", "apple", "app", "apple",
+                                    std::string(1, '\0'), "b", "ab"};
+  std::vector<std::string> sorted(input.size());
+  std::vector<std::string> std_sorted = input;
+  radix_str_sort(input.begin(), input.end(), sorted.begin(), 2);
+  std::sort(std_sorted.begin(), std_sorted.end());
+  EXPECT_EQ(std_sorted, sorted);
+
+  std::vector<std::string> empty, empty_sorted;
+  radix_str_sort(empty.begin(), empty.end(), empty_sorted.begin(), 2);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_pool.h"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Workers spin this many rounds on the generation id before parking, so
+// back to back run() calls do not pay for a futex wake up.
+static const int kSpinRounds = 4096;
+
+ThreadPool::ThreadPool(unsigned int num_threads, bool pin_threads)
+  : _num_threads(num_threads ? num_threads : 1),
+    _generation_id(0), _pending(0) {
+  unsigned int cores = std::thread::hardware_concurrency();
+  for (unsigned int i = 0; i + 1 < _num_threads; i++) {
+    _threads.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+#ifdef __linux__
+    if (pin_threads && cores > 0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(i % cores, &cpuset);
+      pthread_setaffinity_np(_threads.back().native_handle(),
+                             sizeof(cpu_set_t), &cpuset);
+    }
+#else
+    (void)pin_threads;
+    (void)cores;
+#endif
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _start_cond.notify_all();
+  for (auto&& t : _threads)
+    t.join();
+}
+
+void ThreadPool::run(const std::function<void(int)>& task) {
+  if (_num_threads == 1) {
+    task(0);
+    return;
+  }
+  std::lock_guard<std::mutex> run_lock(_run_mutex);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _task = &task;
+    _pending.store(_num_threads - 1, std::memory_order_relaxed);
+    _generation_id.fetch_add(1, std::memory_order_release);
+  }
+  _start_cond.notify_all();
+
+  task(_num_threads - 1);
+
+  for (int i = 0; i < kSpinRounds; i++) {
+    if (_pending.load(std::memory_order_acquire) == 0)
+      return;
+    std::this_thread::yield();
+  }
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_pending.load(std::memory_order_acquire) != 0) {
+    _done_cond.wait(lock);
+  }
+}
+
+void ThreadPool::worker_loop(int thread_id) {
+  unsigned int seen_id = 0;
+  const std::function<void(int)>* task;
+
+  while (true) {
+    for (int i = 0; i < kSpinRounds; i++) {
+      if (_generation_id.load(std::memory_order_acquire) != seen_id)
+        break;
+      std::this_thread::yield();
+    }
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_stop &&
+             _generation_id.load(std::memory_order_acquire) == seen_id) {
+        _start_cond.wait(lock);
+      }
+      if (_stop)
+        return;
+      seen_id = _generation_id.load(std::memory_order_acquire);
+      task = _task;
+    }
+    (*task)(thread_id);
+    if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done_cond.notify_one();
+    }
+  }
+}
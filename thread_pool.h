@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H 1
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of parked worker threads. The calling thread of run() always
+// takes part in the work, so a pool of size n owns n-1 threads.
+class ThreadPool {
+ public:
+  explicit ThreadPool(unsigned int num_threads, bool pin_threads = true);
+  ThreadPool(const ThreadPool&) = delete;
+  ~ThreadPool();
+  unsigned int size() const { return _num_threads; }
+  // Runs task(thread_id) for every thread_id in [0, size()) and returns
+  // once all of them finished. The caller runs thread_id size()-1.
+  void run(const std::function<void(int)>& task);
+ private:
+  void worker_loop(int thread_id);
+  std::mutex _run_mutex;
+  std::mutex _mutex;
+  std::condition_variable _start_cond;
+  std::condition_variable _done_cond;
+  std::vector<std::thread> _threads;
+  const std::function<void(int)>* _task = nullptr;
+  const unsigned int _num_threads;
+  std::atomic_uint _generation_id;
+  std::atomic_uint _pending;
+  bool _stop = false;
+};
+
+// Runs fn(thread_id) for thread_id in [0, num_threads). Reuses the parked
+// workers of pool when one is given (num_threads must be pool->size()),
+// otherwise spawns num_threads-1 threads and joins them.
+template<typename Function>
+void run_on_threads(ThreadPool* pool, int num_threads, Function fn) {
+  if (pool) {
+    pool->run(std::function<void(int)>(fn));
+    return;
+  }
+  std::vector<std::thread> threads(num_threads);
+  for (int i = 0; i < num_threads-1; i++) {
+    threads[i] = std::thread(fn, i);
+  }
+  fn(num_threads-1);
+  for (int i = 0; i < num_threads-1; i++) {
+    threads[i].join();
+  }
+}
+
+#endif
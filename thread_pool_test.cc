@@ -0,0 +1,78 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "thread_barrier.h"
+#include "thread_pool.h"
+
+TEST(thread_pool_test, every_id_runs_once) {
+  int num = 8;
+  ThreadPool pool(num);
+  std::vector<std::atomic_int> hits(num);
+  for (auto&& h : hits)
+    h = 0;
+
+  for (int round = 0; round < 100; round++) {
+    pool.run([&](int thread_id) {
+        hits[thread_id]++;
+      });
+  }
+
+  for (int i = 0; i < num; i++) {
+    EXPECT_EQ(100, hits[i]);
+  }
+}
+
+TEST(thread_pool_test, single_thread_runs_on_caller) {
+  ThreadPool pool(1);
+  std::thread::id caller = std::this_thread::get_id();
+  std::thread::id runner;
+  pool.run([&](int thread_id) {
+      EXPECT_EQ(0, thread_id);
+      runner = std::this_thread::get_id();
+    });
+  EXPECT_EQ(caller, runner);
+}
+
+TEST(thread_pool_test, workers_run_concurrently) {
+  // Tasks that synchronize on a barrier would dead lock unless every
+  // thread id runs at the same time.
+  int num = 6;
+  ThreadPool pool(num);
+  ThreadBarrier barrier(num);
+  std::atomic_uint leader_cnt(0);
+
+  for (int round = 0; round < 10; round++) {
+    pool.run([&](int) {
+        if (barrier.wait())
+          leader_cnt++;
+        barrier.wait();
+      });
+  }
+  EXPECT_EQ(10, leader_cnt);
+}
+
+TEST(thread_pool_test, run_on_threads_without_pool) {
+  int num = 5;
+  std::atomic_int sum(0);
+  run_on_threads(nullptr, num, [&](int thread_id) {
+      sum += thread_id;
+    });
+  EXPECT_EQ(0+1+2+3+4, sum);
+}
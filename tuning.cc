@@ -0,0 +1,146 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "tuning.h"
+
+namespace radix_hash {
+
+static TuningProfile g_profile;
+static std::once_flag g_profile_once;
+
+static void load_env_profile() {
+  const char* path = getenv(kTuningEnv);
+  if (path && *path)
+    g_profile.load(path);
+}
+
+// Profile file format, one setting per line, '#' starts a comment:
+//   insertion_threshold <items>
+//   size_class <max_input> <partition_bits> <num_threads>
+bool TuningProfile::load(const std::string& path) {
+  std::ifstream in(path);
+  std::string line, name;
+  TuningProfile profile;
+
+  if (!in)
+    return false;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line.substr(0, line.find('#')));
+    if (!(fields >> name))
+      continue;
+    if (name == "insertion_threshold") {
+      if (!(fields >> profile.insertion_threshold))
+        return false;
+    } else if (name == "cache") {
+      // Cache sizes written by older versions of radix_tune.
+      continue;
+    } else if (name == "size_class") {
+      SizeClass size_class;
+      if (!(fields >> size_class.max_input >> size_class.partition_bits
+            >> size_class.num_threads))
+        return false;
+      if (size_class.partition_bits < 1 || size_class.partition_bits > 16)
+        return false;
+      profile.size_classes.push_back(size_class);
+    } else {
+      return false;
+    }
+  }
+  std::sort(profile.size_classes.begin(), profile.size_classes.end(),
+            [](const SizeClass& a, const SizeClass& b) {
+              return a.max_input < b.max_input;
+            });
+  *this = profile;
+  return true;
+}
+
+bool TuningProfile::save(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  out << "# FunnelHash tuning profile, written by radix_tune\n";
+  if (insertion_threshold)
+    out << "insertion_threshold " << insertion_threshold << "\n";
+  for (auto&& size_class : size_classes) {
+    out << "size_class " << size_class.max_input << " "
+        << size_class.partition_bits << " "
+        << size_class.num_threads << "\n";
+  }
+  return static_cast<bool>(out);
+}
+
+const TuningProfile::SizeClass*
+TuningProfile::find(std::size_t input_num) const {
+  for (auto&& size_class : size_classes) {
+    if (input_num <= size_class.max_input)
+      return &size_class;
+  }
+  return size_classes.empty() ? nullptr : &size_classes.back();
+}
+
+const TuningProfile& tuning_profile() {
+  std::call_once(g_profile_once, load_env_profile);
+  return g_profile;
+}
+
+void set_tuning_profile(const TuningProfile& profile) {
+  std::call_once(g_profile_once, load_env_profile);
+  g_profile = profile;
+}
+
+int tuned_partition_bits(std::size_t input_num) {
+  const TuningProfile::SizeClass* size_class =
+    tuning_profile().find(input_num);
+  return size_class ? size_class->partition_bits : 0;
+}
+
+int tuned_threads(int num_threads, std::size_t input_num) {
+  if (num_threads > 0)
+    return num_threads;
+  const TuningProfile::SizeClass* size_class =
+    tuning_profile().find(input_num);
+  if (size_class && size_class->num_threads > 0)
+    return size_class->num_threads;
+  unsigned int cores = std::thread::hardware_concurrency();
+  return cores ? cores : 1;
+}
+
+std::size_t insertion_threshold(int partition_bits) {
+  std::size_t threshold = tuning_profile().insertion_threshold;
+  return threshold ? threshold : 1ULL << (partition_bits / 2);
+}
+
+std::size_t detect_cache_size(int level) {
+  long bytes = -1;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+  if (level == 1)
+    bytes = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  else if (level == 2)
+    bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#else
+  (void)level;
+#endif
+  return bytes > 0 ? bytes : 0;
+}
+
+} // namespace radix_hash
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TUNING_H
+#define TUNING_H 1
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace radix_hash {
+
+// Environment variable naming the profile file read on first use.
+static const char kTuningEnv[] = "FUNNELHASH_TUNING";
+
+// Machine specific parameters written by radix_tune. Fields left at 0 fall
+// back to the built in heuristics.
+struct TuningProfile {
+  struct SizeClass {
+    // Applies to inputs of at most max_input items.
+    std::size_t max_input;
+    int partition_bits;
+    int num_threads;
+  };
+  // Sorted by max_input.
+  std::vector<SizeClass> size_classes;
+  // Buckets below this many items are insertion sorted.
+  std::size_t insertion_threshold = 0;
+
+  // Reads a profile written by save(). Returns false and leaves the
+  // profile empty if the file cannot be read or parsed.
+  bool load(const std::string& path);
+  bool save(const std::string& path) const;
+  const SizeClass* find(std::size_t input_num) const;
+};
+
+// The process wide profile, loaded from $FUNNELHASH_TUNING the first time
+// it is needed. Empty when the variable is unset.
+const TuningProfile& tuning_profile();
+// Replaces the process wide profile; must not race with running sorts.
+void set_tuning_profile(const TuningProfile& profile);
+
+// Profile partition bits for input_num items, 0 if there is none.
+int tuned_partition_bits(std::size_t input_num);
+// num_threads if positive, otherwise the profile's choice for input_num,
+// otherwise std::thread::hardware_concurrency().
+int tuned_threads(int num_threads, std::size_t input_num);
+// Bucket size below which the MSD recursion switches to insertion sort.
+std::size_t insertion_threshold(int partition_bits);
+
+// Data cache size of the given level in bytes, 0 if unknown.
+std::size_t detect_cache_size(int level);
+
+} // namespace radix_hash
+
+#endif
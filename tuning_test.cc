@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <random>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "radix_sort.h"
+#include "tuning.h"
+
+using radix_hash::TuningProfile;
+
+static std::string temp_path() {
+  char path[] = "/tmp/tuning_testXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+  return path;
+}
+
+TEST(tuning_test, save_load_round_trip) {
+  TuningProfile profile, loaded;
+  profile.insertion_threshold = 32;
+  profile.size_classes.push_back({1000000, 11, 4});
+  profile.size_classes.push_back({100000, 8, 2});
+  std::string path = temp_path();
+
+  ASSERT_TRUE(profile.save(path));
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(32u, loaded.insertion_threshold);
+  ASSERT_EQ(2u, loaded.size_classes.size());
+  // Classes come back sorted by size.
+  EXPECT_EQ(100000u, loaded.size_classes[0].max_input);
+  EXPECT_EQ(8, loaded.find(5000)->partition_bits);
+  EXPECT_EQ(11, loaded.find(500000)->partition_bits);
+  EXPECT_EQ(4, loaded.find(5000000)->num_threads);
+  // Profiles with the cache sizes older versions wrote still load.
+  {
+    std::ofstream out(path, std::ios::app);
+    out << "cache 2 1048576\n";
+  }
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(2u, loaded.size_classes.size());
+  remove(path.c_str());
+}
+
+TEST(tuning_test, reject_bad_profile) {
+  TuningProfile profile;
+  std::string path = temp_path();
+  {
+    std::ofstream out(path);
+    out << "# comment\nsize_class 100 99 1\n";
+  }
+  EXPECT_FALSE(profile.load(path));
+  EXPECT_TRUE(profile.size_classes.empty());
+  EXPECT_FALSE(profile.load("/nonexistent/profile"));
+  remove(path.c_str());
+}
+
+TEST(tuning_test, profile_drives_defaults) {
+  TuningProfile profile;
+  profile.insertion_threshold = 100;
+  profile.size_classes.push_back({1000, 7, 3});
+  radix_hash::set_tuning_profile(profile);
+
+  EXPECT_EQ(7, radix_hash::optimal_partition(500));
+  EXPECT_EQ(3, radix_hash::tuned_threads(0, 500));
+  EXPECT_EQ(5, radix_hash::tuned_threads(5, 500));
+  EXPECT_EQ(100u, radix_hash::insertion_threshold(12));
+
+  // Sorting with tuned parameters and num_threads <= 0.
+  int size = 20000;
+  std::vector<std::pair<std::size_t, int>> src, dst(size), std_sorted;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<std::size_t> distribution;
+  for (int i = 0; i < size; i++)
+    src.push_back(std::make_pair(distribution(generator), i));
+  std_sorted = src;
+  std::sort(std_sorted.begin(), std_sorted.end());
+  ::radix_int_non_inplace<std::size_t,int>(src.begin(), src.end(), dst.begin(), 0);
+  EXPECT_EQ(std_sorted, dst);
+
+  radix_hash::set_tuning_profile(TuningProfile());
+  EXPECT_EQ(1u << 6, radix_hash::insertion_threshold(12));
+  unsigned int cores = std::thread::hardware_concurrency();
+  EXPECT_EQ(static_cast<int>(cores ? cores : 1), radix_hash::tuned_threads(-1, 500));
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thread>
+#include "work_stealing.h"
+
+SortTaskQueues::SortTaskQueues(
+    int num_threads,
+    const std::vector<std::pair<std::size_t, std::size_t>>* super_indexes,
+    int mask_bits)
+  : _super_indexes(super_indexes),
+    _mask_bits(mask_bits),
+    _partitions(super_indexes->size()),
+    _super_counter(0),
+    _pending(super_indexes->size()) {
+  for (int i = 0; i < num_threads; i++) {
+    _queues.push_back(std::unique_ptr<Queue>(new Queue));
+  }
+}
+
+void SortTaskQueues::push(int thread_id, const SortTask& task) {
+  _pending.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(_queues[thread_id]->mutex);
+  _queues[thread_id]->tasks.push_back(task);
+}
+
+bool SortTaskQueues::pop(int queue_id, bool newest, SortTask* task) {
+  Queue* queue = _queues[queue_id].get();
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  if (queue->tasks.empty())
+    return false;
+  if (newest) {
+    *task = queue->tasks.back();
+    queue->tasks.pop_back();
+  } else {
+    *task = queue->tasks.front();
+    queue->tasks.pop_front();
+  }
+  return true;
+}
+
+bool SortTaskQueues::next(int thread_id, SortTask* task) {
+  int num_queues = _queues.size();
+  int s_idx;
+
+  while (true) {
+    if (pop(thread_id, true, task))
+      return true;
+
+    s_idx = _super_counter.fetch_add(1, std::memory_order_relaxed);
+    while (s_idx < _partitions) {
+      task->begin = (*_super_indexes)[s_idx].first;
+      task->end = (*_super_indexes)[s_idx].second;
+      task->mask_bits = _mask_bits;
+      task->in_scratch = false;
+      if (task->end - task->begin >= 2)
+        return true;
+      finish();
+      s_idx = _super_counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    for (int i = 1; i < num_queues; i++) {
+      if (pop((thread_id + i) % num_queues, false, task))
+        return true;
+    }
+    // Tasks in flight may still split into stealable work.
+    if (_pending.load(std::memory_order_acquire) == 0)
+      return false;
+    std::this_thread::yield();
+  }
+}
+
+void SortTaskQueues::finish() {
+  _pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+MsdScratch::MsdScratch(int mask_bits, int partition_bits)
+  : _partitions(1 << partition_bits),
+    _counters(_partitions) {
+  int levels = mask_bits > partition_bits ?
+    (mask_bits + partition_bits - 1) / partition_bits : 1;
+  _ends.resize(static_cast<std::size_t>(levels) * _partitions);
+  _frames.resize(levels);
+}
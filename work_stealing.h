@@ -0,0 +1,177 @@
+/*
+ * Copyright 2018 Felix Chern
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H 1
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Sub-partitions at least this large are handed to the scheduler instead
+// of being finished by the thread that produced them.
+static const std::size_t kStealThreshold = 1 << 14;
+
+// [begin, end) still needs sorting on the low mask_bits bits.
+struct SortTask {
+  std::size_t begin;
+  std::size_t end;
+  int mask_bits;
+  // Stable sorts only: the items currently live in the scratch array.
+  bool in_scratch;
+};
+
+// Task scheduler for the recursive phase of the MSD sorts. Work starts as
+// the top level partitions of the scatter phase; any thread may split a
+// large sub-partition into new tasks, which idle threads steal.
+class SortTaskQueues {
+ public:
+  // super_indexes is read lazily, it only has to be filled in before the
+  // first call to next().
+  SortTaskQueues(int num_threads,
+                 const std::vector<std::pair<std::size_t, std::size_t>>*
+                 super_indexes,
+                 int mask_bits);
+  SortTaskQueues(const SortTaskQueues&) = delete;
+  // Changes the mask_bits of the top level partitions, under the same
+  // rule as super_indexes.
+  void set_mask_bits(int mask_bits) { _mask_bits = mask_bits; }
+  int mask_bits() const { return _mask_bits; }
+  void push(int thread_id, const SortTask& task);
+  // Picks the newest task of thread_id, then the next top level partition,
+  // then the oldest task of another thread. Returns false once every task
+  // has finished. Each task returned must be followed by finish().
+  bool next(int thread_id, SortTask* task);
+  void finish();
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<SortTask> tasks;
+    char padding[64];
+  };
+  bool pop(int queue_id, bool newest, SortTask* task);
+  std::vector<std::unique_ptr<Queue>> _queues;
+  const std::vector<std::pair<std::size_t, std::size_t>>* _super_indexes;
+  int _mask_bits;
+  const int _partitions;
+  std::atomic_int _super_counter;
+  std::atomic_long _pending;
+};
+
+// A range split into buckets by msd_sort(): bucket i ends at ends[i], and
+// begin is where the next one to visit starts.
+struct MsdFrame {
+  const std::size_t* ends;
+  std::size_t begin;
+  int next;
+  int mask_bits;
+  bool in_scratch;
+  // Buckets of kStealThreshold items or more went to the queues.
+  bool pushed;
+};
+
+// Per thread scratch of the MSD sorts: the digit counters, and the bucket
+// ends and frame of every level of the msd_sort() stack. Sized once per
+// sort, so that the recursive phase allocates nothing.
+class MsdScratch {
+ public:
+  // Room for ranges of up to mask_bits bits split partition_bits at a time,
+  // i.e. ceil(mask_bits / partition_bits) levels.
+  MsdScratch(int mask_bits, int partition_bits);
+  MsdScratch(const MsdScratch&) = delete;
+  int partitions() const { return _partitions; }
+  std::size_t* counters() { return _counters.data(); }
+  std::size_t* ends(int level) {
+    return &_ends[static_cast<std::size_t>(level) * _partitions];
+  }
+  MsdFrame* frames() { return _frames.data(); }
+ private:
+  const int _partitions;
+  std::vector<std::size_t> _counters;
+  std::vector<std::size_t> _ends;
+  std::vector<MsdFrame> _frames;
+};
+
+// Moves frame to its next bucket left to sort, false once there is none.
+static inline bool msd_next_bucket(MsdFrame* frame,
+                                   int partitions,
+                                   std::size_t* begin,
+                                   std::size_t* end) {
+  while (frame->next < partitions) {
+    *begin = frame->begin;
+    *end = frame->begin = frame->ends[frame->next++];
+    if (*end > *begin &&
+        !(frame->pushed && *end - *begin >= kStealThreshold))
+      return true;
+  }
+  return false;
+}
+
+// Sorts [begin, end) on its low mask_bits bits, depth first on the
+// explicit stack of scratch instead of recursing.
+// split(begin, end, mask_bits, &in_scratch, ends) either finishes the
+// range and returns 0, or partitions it into buckets, bucket i ending at
+// ends[i], and returns the bits left below its digit, at least
+// partition_bits fewer than mask_bits. A stable sort flips in_scratch
+// when the buckets land in its other array. With queues, buckets of
+// kStealThreshold items or more become tasks instead.
+template<typename Split>
+void msd_sort(std::size_t begin,
+              std::size_t end,
+              int mask_bits,
+              bool in_scratch,
+              MsdScratch* scratch,
+              SortTaskQueues* queues,
+              int thread_id,
+              Split split) {
+  MsdFrame* frames = scratch->frames();
+  std::size_t* ends;
+  std::size_t b_begin;
+  int partitions = scratch->partitions(), top = -1, bits;
+  bool pushed;
+
+  while (true) {
+    ends = scratch->ends(top + 1);
+    bits = split(begin, end, mask_bits, &in_scratch, ends);
+    if (bits > 0) {
+      // No bucket of a smaller range can reach kStealThreshold.
+      pushed = queues && end - begin >= kStealThreshold;
+      b_begin = begin;
+      for (int i = 0; pushed && i < partitions; i++) {
+        if (ends[i] - b_begin >= kStealThreshold) {
+          queues->push(thread_id, SortTask{b_begin, ends[i], bits,
+                in_scratch});
+        }
+        b_begin = ends[i];
+      }
+      frames[++top] = MsdFrame{ends, begin, 0, bits, in_scratch, pushed};
+    }
+    // Unwind to the next bucket left to sort.
+    while (top >= 0 && !msd_next_bucket(&frames[top], partitions, &begin,
+                                        &end))
+      top--;
+    if (top < 0)
+      return;
+    mask_bits = frames[top].mask_bits;
+    in_scratch = frames[top].in_scratch;
+  }
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2018 Felix Chern
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "work_stealing.h"
+
+TEST(work_stealing_test, single_thread_order) {
+  std::vector<std::pair<std::size_t, std::size_t>> indexes;
+  indexes.push_back(std::make_pair(0, 10));
+  indexes.push_back(std::make_pair(10, 11));  // too small, skipped
+  indexes.push_back(std::make_pair(11, 20));
+  SortTaskQueues queues(1, &indexes, 7);
+  SortTask task;
+
+  ASSERT_TRUE(queues.next(0, &task));
+  EXPECT_EQ(0u, task.begin);
+  EXPECT_EQ(10u, task.end);
+  EXPECT_EQ(7, task.mask_bits);
+  // Own tasks come before the remaining top level partitions.
+  queues.push(0, SortTask{2, 5, 3, false});
+  queues.push(0, SortTask{5, 9, 3, false});
+  queues.finish();
+
+  ASSERT_TRUE(queues.next(0, &task));
+  EXPECT_EQ(5u, task.begin);
+  queues.finish();
+  ASSERT_TRUE(queues.next(0, &task));
+  EXPECT_EQ(2u, task.begin);
+  queues.finish();
+  ASSERT_TRUE(queues.next(0, &task));
+  EXPECT_EQ(11u, task.begin);
+  EXPECT_EQ(20u, task.end);
+  queues.finish();
+  EXPECT_FALSE(queues.next(0, &task));
+}
+
+TEST(work_stealing_test, idle_threads_steal) {
+  // Thread 0 owns the only top level partition and splits it into many
+  // tasks; every task must run exactly once and all threads terminate.
+  int num_threads = 4;
+  int num_tasks = 1000;
+  std::vector<std::pair<std::size_t, std::size_t>> indexes;
+  indexes.push_back(std::make_pair(0, num_tasks));
+  SortTaskQueues queues(num_threads, &indexes, 8);
+  std::vector<std::atomic_int> runs(num_tasks);
+  std::vector<std::thread> threads;
+  for (auto&& r : runs)
+    r = 0;
+
+  for (int t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&, t]() {
+          SortTask task;
+          while (queues.next(t, &task)) {
+            if (task.mask_bits == 8) {
+              for (int i = 0; i < num_tasks; i++)
+                queues.push(t, SortTask{std::size_t(i), std::size_t(i) + 1,
+                                        0, false});
+            } else {
+              runs[task.begin]++;
+              std::this_thread::yield();
+            }
+            queues.finish();
+          }
+        }));
+  }
+  for (auto&& t : threads)
+    t.join();
+
+  for (int i = 0; i < num_tasks; i++) {
+    EXPECT_EQ(1, runs[i]);
+  }
+}
+
+TEST(work_stealing_test, msd_sort_explicit_stack) {
+  // 16 bits split 4 at a time needs every level of the scratch stack.
+  int partition_bits = 4, partitions = 1 << partition_bits;
+  std::vector<unsigned> keys;
+  for (unsigned i = 0; i < 5000; i++)
+    keys.push_back((i * 40503u) & 0xffffu);
+  MsdScratch scratch(16, partition_bits);
+  int max_depth = 0;
+
+  msd_sort(0, keys.size(), 16, false, &scratch, nullptr, 0,
+           [&](std::size_t begin, std::size_t end, int mask_bits, bool*,
+               std::size_t* ends) {
+             int shift = mask_bits - partition_bits;
+             auto digit = [&](unsigned k) {
+               return static_cast<int>((k >> shift) & (partitions - 1));
+             };
+             max_depth = std::max(max_depth, (16 - mask_bits) /
+                                  partition_bits + 1);
+             std::stable_sort(keys.begin() + begin, keys.begin() + end,
+                              [&](unsigned a, unsigned b) {
+                                return digit(a) < digit(b);
+                              });
+             for (int i = 0; i < partitions; i++) {
+               ends[i] = begin;
+               while (ends[i] < end && digit(keys[ends[i]]) <= i)
+                 ends[i]++;
+               begin = ends[i];
+             }
+             return shift;
+           });
+
+  EXPECT_EQ(4, max_depth);
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}